@@ -0,0 +1,265 @@
+/* запись и загрузка двоичного снимка транспортного справочника */
+#include "catalogue_serialization.h"
+#include "mapped_file.h"
+
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace transport {
+    namespace serialization {
+
+        using namespace catalogue;
+        using namespace std::literals;
+
+        namespace {
+            constexpr std::string_view SNAPSHOT_MAGIC = "TCSNAPSH"sv;
+            constexpr size_t HEADER_SIZE = 96;
+            constexpr size_t STOP_RECORD_SIZE = 32;
+            constexpr size_t DISTANCE_RECORD_SIZE = 16;
+            constexpr size_t BUS_RECORD_SIZE = 72;
+            constexpr size_t STOP_REF_SIZE = 4;
+            constexpr size_t SECTION_ALIGN = 8;
+            constexpr uint32_t BUS_FLAG_ROUNDTRIP = 1;
+
+            /* ---------------- запись чисел в little-endian независимо от порядка байт платформы ---------------- */
+
+            void WriteUint(std::ostream &output, uint64_t value, size_t byte_count) {
+                char bytes[8];
+                for (size_t i = 0; i != byte_count; ++i) {
+                    bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+                }
+                output.write(bytes, static_cast<std::streamsize>(byte_count));
+            }
+
+            void WriteU32(std::ostream &output, uint32_t value) {
+                WriteUint(output, value, 4);
+            }
+
+            void WriteU64(std::ostream &output, uint64_t value) {
+                WriteUint(output, value, 8);
+            }
+
+            void WriteDouble(std::ostream &output, double value) {
+                uint64_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                WriteU64(output, bits);
+            }
+
+            void WritePadding(std::ostream &output, size_t written) {
+                static const char zeros[SECTION_ALIGN] = {};
+                output.write(zeros, static_cast<std::streamsize>((SECTION_ALIGN - written % SECTION_ALIGN) % SECTION_ALIGN));
+            }
+
+            size_t AlignUp(size_t value) {
+                return (value + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+            }
+
+            /* ---------------- чтение чисел из little-endian (на little-endian платформе компилируется в обычную загрузку) ---------------- */
+
+            uint64_t ReadUint(const char *data, size_t byte_count) {
+                uint64_t value = 0;
+                for (size_t i = 0; i != byte_count; ++i) {
+                    value |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+                }
+                return value;
+            }
+
+            uint32_t ReadU32(const char *data) {
+                return static_cast<uint32_t>(ReadUint(data, 4));
+            }
+
+            uint64_t ReadU64(const char *data) {
+                return ReadUint(data, 8);
+            }
+
+            double ReadDouble(const char *data) {
+                const uint64_t bits = ReadU64(data);
+                double value;
+                std::memcpy(&value, &bits, sizeof(value));
+                return value;
+            }
+
+            /* Проверяет, что секция из count записей размером record_size по смещению offset целиком лежит в файле */
+            void CheckSection(std::string_view data, uint64_t offset, uint64_t count, size_t record_size, std::string_view section) {
+                if (offset > data.size() || count > (data.size() - offset) / record_size) {
+                    throw SnapshotError("Snapshot section "s + std::string(section) + " is out of file bounds"s);
+                }
+            }
+        } // namespace
+
+        void SaveCatalogue(const TransportCatalogue &catalogue, std::ostream &output) {
+            size_t stop_count = 0;
+            size_t strings_size = 0;
+            for (const Stop &stop : catalogue.GetStops()) {
+                ++stop_count;
+                strings_size += stop.name.size();
+            }
+            size_t distance_count = 0;
+            for ([[maybe_unused]] const auto &distance : catalogue.GetStopDistances()) {
+                ++distance_count;
+            }
+            size_t bus_count = 0;
+            size_t stop_ref_count = 0;
+            for (const Bus &bus : catalogue.GetBuses()) {
+                ++bus_count;
+                strings_size += bus.name.size();
+                stop_ref_count += bus.stops.size();
+            }
+
+            const size_t strings_offset = HEADER_SIZE;
+            const size_t stops_offset = AlignUp(strings_offset + strings_size);
+            const size_t distances_offset = stops_offset + stop_count * STOP_RECORD_SIZE;
+            const size_t buses_offset = distances_offset + distance_count * DISTANCE_RECORD_SIZE;
+            const size_t stop_refs_offset = buses_offset + bus_count * BUS_RECORD_SIZE;
+
+            // заголовок
+            output.write(SNAPSHOT_MAGIC.data(), static_cast<std::streamsize>(SNAPSHOT_MAGIC.size()));
+            WriteU32(output, SNAPSHOT_FORMAT_VERSION);
+            WriteU32(output, 0);
+            for (size_t value : {stop_count, distance_count, bus_count, stop_ref_count, strings_size,
+                                 strings_offset, stops_offset, distances_offset, buses_offset, stop_refs_offset}) {
+                WriteU64(output, value);
+            }
+
+            // таблица строк: сначала имена остановок, затем имена маршрутов
+            for (const Stop &stop : catalogue.GetStops()) {
+                output.write(stop.name.data(), static_cast<std::streamsize>(stop.name.size()));
+            }
+            for (const Bus &bus : catalogue.GetBuses()) {
+                output.write(bus.name.data(), static_cast<std::streamsize>(bus.name.size()));
+            }
+            WritePadding(output, strings_offset + strings_size);
+
+            size_t name_offset = 0;
+            for (const Stop &stop : catalogue.GetStops()) {
+                WriteDouble(output, stop.location.lat);
+                WriteDouble(output, stop.location.lng);
+                WriteU64(output, name_offset);
+                WriteU32(output, static_cast<uint32_t>(stop.name.size()));
+                WriteU32(output, 0);
+                name_offset += stop.name.size();
+            }
+
+            for (const auto &[stops, distance] : catalogue.GetStopDistances()) {
+                WriteU32(output, static_cast<uint32_t>(stops.first->id));
+                WriteU32(output, static_cast<uint32_t>(stops.second->id));
+                WriteU64(output, distance);
+            }
+
+            size_t first_stop_ref = 0;
+            for (const Bus &bus : catalogue.GetBuses()) {
+                WriteU64(output, name_offset);
+                WriteU32(output, static_cast<uint32_t>(bus.name.size()));
+                WriteU32(output, bus.is_roundtrip_ ? BUS_FLAG_ROUNDTRIP : 0);
+                WriteU64(output, first_stop_ref);
+                WriteU64(output, bus.stops.size());
+                WriteDouble(output, bus.bus_stat.length);
+                WriteDouble(output, bus.bus_stat.curvature);
+                WriteU64(output, bus.bus_stat.distance);
+                WriteU64(output, bus.bus_stat.stops_num);
+                WriteU64(output, bus.bus_stat.uniq_stops_num);
+                name_offset += bus.name.size();
+                first_stop_ref += bus.stops.size();
+            }
+
+            for (const Bus &bus : catalogue.GetBuses()) {
+                for (const Stop *stop : bus.stops) {
+                    WriteU32(output, static_cast<uint32_t>(stop->id));
+                }
+            }
+
+            if (!output) {
+                throw SnapshotError("Failed to write catalogue snapshot"s);
+            }
+        }
+
+        std::shared_ptr<const TransportCatalogue> LoadCatalogue(const std::string &path) {
+            std::shared_ptr<const MappedFile> file = std::make_shared<const MappedFile>(path);
+            const std::string_view data = file->GetData();
+
+            if (data.size() < HEADER_SIZE || data.substr(0, SNAPSHOT_MAGIC.size()) != SNAPSHOT_MAGIC) {
+                throw SnapshotError("File "s + path + " is not a catalogue snapshot"s);
+            }
+            if (const uint32_t version = ReadU32(data.data() + 8); version != SNAPSHOT_FORMAT_VERSION) {
+                throw SnapshotError("Unsupported catalogue snapshot version "s + std::to_string(version));
+            }
+            const char *header = data.data() + 16;
+            const uint64_t stop_count = ReadU64(header);
+            const uint64_t distance_count = ReadU64(header + 8);
+            const uint64_t bus_count = ReadU64(header + 16);
+            const uint64_t stop_ref_count = ReadU64(header + 24);
+            const uint64_t strings_size = ReadU64(header + 32);
+            const uint64_t strings_offset = ReadU64(header + 40);
+            const uint64_t stops_offset = ReadU64(header + 48);
+            const uint64_t distances_offset = ReadU64(header + 56);
+            const uint64_t buses_offset = ReadU64(header + 64);
+            const uint64_t stop_refs_offset = ReadU64(header + 72);
+
+            CheckSection(data, strings_offset, strings_size, 1, "strings"sv);
+            CheckSection(data, stops_offset, stop_count, STOP_RECORD_SIZE, "stops"sv);
+            CheckSection(data, distances_offset, distance_count, DISTANCE_RECORD_SIZE, "distances"sv);
+            CheckSection(data, buses_offset, bus_count, BUS_RECORD_SIZE, "buses"sv);
+            CheckSection(data, stop_refs_offset, stop_ref_count, STOP_REF_SIZE, "stop references"sv);
+
+            const std::string_view strings = data.substr(strings_offset, strings_size);
+            auto get_name = [&strings](uint64_t offset, uint32_t length) {
+                if (offset > strings.size() || length > strings.size() - offset) {
+                    throw SnapshotError("Snapshot name is out of string table bounds"s);
+                }
+                return strings.substr(offset, length);
+            };
+
+            CatalogueBuilder builder;
+            builder.AdoptNameStorage(file, strings);
+
+            std::vector<std::string_view> stop_names;
+            stop_names.reserve(stop_count);
+            for (const char *record = data.data() + stops_offset; stop_names.size() != stop_count; record += STOP_RECORD_SIZE) {
+                stop_names.push_back(get_name(ReadU64(record + 16), ReadU32(record + 24)));
+                builder.AddStop(stop_names.back(), {ReadDouble(record), ReadDouble(record + 8)});
+            }
+
+            const char *record = data.data() + distances_offset;
+            for (uint64_t i = 0; i != distance_count; ++i, record += DISTANCE_RECORD_SIZE) {
+                const uint32_t from_id = ReadU32(record);
+                const uint32_t to_id = ReadU32(record + 4);
+                if (from_id >= stop_count || to_id >= stop_count) {
+                    throw SnapshotError("Snapshot distance refers to unknown stop"s);
+                }
+                builder.AddStopDistances(stop_names[from_id], stop_names[to_id], ReadU64(record + 8));
+            }
+
+            const char *stop_refs = data.data() + stop_refs_offset;
+            std::vector<std::string_view> bus_stops;
+            record = data.data() + buses_offset;
+            for (uint64_t i = 0; i != bus_count; ++i, record += BUS_RECORD_SIZE) {
+                const uint64_t first_stop_ref = ReadU64(record + 16);
+                const uint64_t bus_stop_count = ReadU64(record + 24);
+                if (first_stop_ref > stop_ref_count || bus_stop_count > stop_ref_count - first_stop_ref) {
+                    throw SnapshotError("Snapshot bus stops are out of bounds"s);
+                }
+                bus_stops.clear();
+                for (uint64_t ref = first_stop_ref; ref != first_stop_ref + bus_stop_count; ++ref) {
+                    const uint32_t stop_id = ReadU32(stop_refs + ref * STOP_REF_SIZE);
+                    if (stop_id >= stop_count) {
+                        throw SnapshotError("Snapshot bus refers to unknown stop"s);
+                    }
+                    bus_stops.push_back(stop_names[stop_id]);
+                }
+
+                BusStatistics bus_stat;
+                bus_stat.length = ReadDouble(record + 32);
+                bus_stat.curvature = ReadDouble(record + 40);
+                bus_stat.distance = ReadU64(record + 48);
+                bus_stat.stops_num = ReadU64(record + 56);
+                bus_stat.uniq_stops_num = ReadU64(record + 64);
+                builder.AddBus(get_name(ReadU64(record), ReadU32(record + 8)), bus_stops,
+                               (ReadU32(record + 12) & BUS_FLAG_ROUNDTRIP) != 0, bus_stat);
+            }
+
+            return builder.Build();
+        }
+
+    } // namespace serialization
+} // namespace transport
@@ -0,0 +1,49 @@
+#pragma once
+/*
+ * Двоичный снимок транспортного справочника.
+ * Снимок сохраняется один раз (SaveCatalogue) и затем загружается при старте вместо разбора base_requests из JSON (LoadCatalogue).
+ * Файл загружается через mmap: записи фиксированного размера читаются напрямую из отображённой памяти, без разбора текста,
+ * имена остановок и маршрутов не копируются - справочник ссылается на строки прямо в отображённом файле.
+ * Несколько процессов, загрузивших один и тот же файл, разделяют его страницы памяти (отображение только для чтения).
+ *
+ * Формат файла (все числа little-endian, секции выровнены по 8 байт):
+ * 1) Заголовок, 96 байт:
+ *    - magic "TCSNAPSH" (8 байт), версия формата uint32, зарезервировано uint32;
+ *    - uint64: количество остановок, расстояний, маршрутов, ссылок маршрутов на остановки, размер таблицы строк;
+ *    - uint64: смещения секций строк, остановок, расстояний, маршрутов, ссылок на остановки от начала файла.
+ * 2) Таблица строк: имена остановок и маршрутов подряд, без разделителей.
+ * 3) Остановки, по 32 байта: широта double, долгота double, смещение имени в таблице строк uint64, длина имени uint32, резерв uint32.
+ * 4) Расстояния, по 16 байт: номер остановки "откуда" uint32, номер остановки "куда" uint32, расстояние в метрах uint64.
+ * 5) Маршруты, по 72 байта: смещение имени uint64, длина имени uint32, флаги uint32 (бит 0 - кольцевой маршрут),
+ *    индекс первой ссылки на остановку uint64, количество хранимых остановок uint64 (у некольцевого маршрута - только прямое направление),
+ *    статистика: длина double, извилистость double, дорожная длина uint64, количество остановок uint64, уникальных остановок uint64.
+ * 6) Ссылки маршрутов на остановки: номера остановок uint32.
+ *
+ * При несовпадении magic, версии формата или выходе секций за пределы файла выбрасывается SnapshotError.
+ */
+#include "transport_catalogue.h"
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+namespace transport {
+    namespace serialization {
+
+        inline constexpr uint32_t SNAPSHOT_FORMAT_VERSION = 2; // 2: некольцевые маршруты хранятся в одном направлении
+
+        class SnapshotError : public std::runtime_error {
+        public:
+            using runtime_error::runtime_error;
+        };
+
+        /* Записывает снимок завершённого справочника в поток (поток должен быть открыт в двоичном режиме) */
+        void SaveCatalogue(const catalogue::TransportCatalogue &catalogue, std::ostream &output);
+
+        /* Отображает файл снимка в память и строит по нему справочник */
+        std::shared_ptr<const catalogue::TransportCatalogue> LoadCatalogue(const std::string &path);
+
+    } // namespace serialization
+} // namespace transport
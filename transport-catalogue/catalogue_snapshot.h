@@ -0,0 +1,38 @@
+#pragma once
+/*
+ * Хранилище текущего снимка транспортного справочника.
+ * 1) Читатели (обработчики запросов) берут снимок методом Get и держат std::shared_ptr на него всё время обработки пачки запросов.
+ * Пока читатель держит снимок, тот не будет удалён, даже если уже опубликован более новый.
+ * 2) Загрузчик строит новый справочник через CatalogueBuilder в своём потоке и публикует его методом Publish.
+ * Публикация - атомарная подмена указателя: читатели не ждут построения нового справочника, а загрузчик не ждёт читателей.
+ * Старый снимок освобождается, когда его отпустит последний читатель.
+ */
+#include "transport_catalogue.h"
+
+#include <atomic>
+#include <memory>
+
+namespace transport {
+    namespace catalogue {
+
+        class CatalogueSnapshotHolder {
+        public:
+            CatalogueSnapshotHolder() = default;
+            explicit CatalogueSnapshotHolder(std::shared_ptr<const TransportCatalogue> snapshot)
+                : snapshot_(std::move(snapshot)) {
+            }
+
+            std::shared_ptr<const TransportCatalogue> Get() const {
+                return std::atomic_load_explicit(&snapshot_, std::memory_order_acquire);
+            }
+
+            void Publish(std::shared_ptr<const TransportCatalogue> snapshot) {
+                std::atomic_store_explicit(&snapshot_, std::move(snapshot), std::memory_order_release);
+            }
+
+        private:
+            std::shared_ptr<const TransportCatalogue> snapshot_;
+        };
+
+    } // namespace catalogue
+} // namespace transport
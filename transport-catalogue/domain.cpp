@@ -3,6 +3,7 @@
  * Операции сравнения над объектами:
  * 1) автобусных остановок
  * 2) автобусов
+ * Полная последовательность остановок маршрута
  */
 
 #include "domain.h"
@@ -16,8 +17,23 @@ namespace transport {
             return !(*this != rhs);
         }
 
+        size_t Bus::GetRouteStopCount() const noexcept {
+            if (is_roundtrip_ || stops.empty()) {
+                return stops.size();
+            }
+            return 2 * stops.size() - 1;
+        }
+
+        ranges::Range<RouteStopIterator> Bus::GetRouteStops() const noexcept {
+            return {RouteStopIterator(&stops, 0), RouteStopIterator(&stops, GetRouteStopCount())};
+        }
+
+        const Stop *Bus::GetRouteStop(size_t pos) const noexcept {
+            return *RouteStopIterator(&stops, pos);
+        }
+
         [[nodiscard]] bool Bus::operator!=(const Bus &rhs) const noexcept {
-            if (name != rhs.name) {
+            if (name != rhs.name || is_roundtrip_ != rhs.is_roundtrip_) {
                 return true;
             }
             if (stops.size() != rhs.stops.size()) {
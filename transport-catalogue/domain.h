@@ -3,7 +3,8 @@
  * Структуры:
  * 1) Остановка, каждая запись об остановке содержит:
  * - координаты остановки: широту и долготу;
- * - имя остановки;
+ * - имя остановки (строка хранится в пуле имён справочника);
+ * - порядковый номер остановки в справочнике;
  * 2) Информация о маршруте (для выдачи статистики):
  * - географическая длина маршрута;
  * - извилистость, то есть отношение фактической длины маршрута к географическому расстоянию;
@@ -12,12 +13,20 @@
  * - количество уникальных остановок;
  * 3) Автобус, каждая запись о маршруте содержит:
  * - информацию о маршруте (для выдачи статистики)
- * - имя маршрута;
- * - последовательный список всех остановок маршрута;
+ * - имя маршрута (строка хранится в пуле имён справочника);
+ * - порядковый номер маршрута в справочнике;
+ * - остановки маршрута в прямом направлении (для некольцевого маршрута обратное направление не хранится);
+ * - признак кольцевого маршрута;
+ * 4) Итератор по полной последовательности остановок маршрута (RouteStopIterator): для некольцевого маршрута
+ * после конечной остановки выдаёт остановки прямого направления в обратном порядке, ничего не копируя.
+ * Полную последовательность отдаёт Bus::GetRouteStops, её длину - Bus::GetRouteStopCount.
  */
 #include "geo.h"
+#include "ranges.h"
 
-#include <string>
+#include <cstddef>
+#include <iterator>
+#include <string_view>
 #include <vector>
 
 namespace transport {
@@ -25,7 +34,8 @@ namespace transport {
 
         struct Stop {
             geo::Coordinates location;
-            std::string name;
+            std::string_view name;
+            size_t id = 0;
 
             [[nodiscard]] bool operator!=(const Stop &rhs) const noexcept;
             [[nodiscard]] bool operator==(const Stop &rhs) const noexcept;
@@ -39,12 +49,70 @@ namespace transport {
             size_t uniq_stops_num = 0;
         };
 
+        /* Позиция pos полной последовательности "туда и обратно" из n хранимых остановок: до n - прямой ход, дальше - обратный */
+        class RouteStopIterator {
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = const Stop *;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const Stop *const *;
+            using reference = const Stop *const &;
+
+            RouteStopIterator() = default;
+            RouteStopIterator(const std::vector<const Stop *> *stops, size_t pos)
+                : stops_(stops), pos_(pos) {}
+
+            reference operator*() const {
+                const size_t size = stops_->size();
+                return (*stops_)[pos_ < size ? pos_ : 2 * size - 2 - pos_];
+            }
+            pointer operator->() const {
+                return &**this;
+            }
+            RouteStopIterator &operator++() {
+                ++pos_;
+                return *this;
+            }
+            RouteStopIterator operator++(int) {
+                RouteStopIterator old = *this;
+                ++pos_;
+                return old;
+            }
+            RouteStopIterator &operator--() {
+                --pos_;
+                return *this;
+            }
+            RouteStopIterator operator--(int) {
+                RouteStopIterator old = *this;
+                --pos_;
+                return old;
+            }
+            [[nodiscard]] bool operator==(const RouteStopIterator &rhs) const noexcept {
+                return pos_ == rhs.pos_ && stops_ == rhs.stops_;
+            }
+            [[nodiscard]] bool operator!=(const RouteStopIterator &rhs) const noexcept {
+                return !(*this == rhs);
+            }
+
+        private:
+            const std::vector<const Stop *> *stops_ = nullptr;
+            size_t pos_ = 0;
+        };
+
         struct Bus {
             BusStatistics bus_stat;
-            std::string name;
-            std::vector<Stop *> stops;
+            std::string_view name;
+            size_t id = 0;
+            std::vector<const Stop *> stops; // прямое направление; у кольцевого маршрута последняя остановка совпадает с первой
             bool is_roundtrip_;
 
+            /* Количество остановок полной последовательности: у некольцевого маршрута из n остановок это 2 * n - 1 */
+            size_t GetRouteStopCount() const noexcept;
+            /* Полная последовательность остановок маршрута, для некольцевого - туда и обратно */
+            ranges::Range<RouteStopIterator> GetRouteStops() const noexcept;
+            /* Остановка на позиции pos полной последовательности, pos < GetRouteStopCount() */
+            const Stop *GetRouteStop(size_t pos) const noexcept;
+
             [[nodiscard]] bool operator!=(const Bus &rhs) const noexcept;
             [[nodiscard]] bool operator==(const Bus &rhs) const noexcept;
         };
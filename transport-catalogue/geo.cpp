@@ -6,8 +6,71 @@
 #include "geo.h"
 #include <cmath>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEO_HAS_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
 namespace geo {
 
+    namespace {
+        const double DEG_TO_RAD = M_PI / 180.;
+        const double EARTH_RADIUS = 6371000;
+        constexpr size_t BATCH_CHUNK = 64; // пары точек обрабатываются порциями, буферы порции лежат на стеке
+
+        /* Порция пар точек (a, b): тригонометрия обеих точек и cos разности долгот */
+        struct PairChunk {
+            double sin_a[BATCH_CHUNK];
+            double cos_a[BATCH_CHUNK];
+            double sin_b[BATCH_CHUNK];
+            double cos_b[BATCH_CHUNK];
+            double cos_dlng[BATCH_CHUNK];
+            bool same[BATCH_CHUNK]; // точки совпадают - расстояние 0, как в ComputeDistance
+        };
+
+        void CombineScalar(const PairChunk &chunk, size_t begin, size_t count, double *dot) {
+            for (size_t k = begin; k != count; ++k) {
+                dot[k] = chunk.sin_a[k] * chunk.sin_b[k] + chunk.cos_a[k] * chunk.cos_b[k] * chunk.cos_dlng[k];
+            }
+        }
+
+#ifdef GEO_HAS_AVX2_KERNEL
+        /* Без FMA: умножения и сложение округляются так же, как в скалярном коде */
+        __attribute__((target("avx2")))
+        void CombineAvx2(const PairChunk &chunk, size_t count, double *dot) {
+            size_t k = 0;
+            for (; k + 4 <= count; k += 4) {
+                const __m256d sin_part = _mm256_mul_pd(_mm256_loadu_pd(chunk.sin_a + k), _mm256_loadu_pd(chunk.sin_b + k));
+                const __m256d cos_part = _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(chunk.cos_a + k), _mm256_loadu_pd(chunk.cos_b + k)),
+                                                       _mm256_loadu_pd(chunk.cos_dlng + k));
+                _mm256_storeu_pd(dot + k, _mm256_add_pd(sin_part, cos_part));
+            }
+            CombineScalar(chunk, k, count, dot);
+        }
+
+        bool HasAvx2() {
+            static const bool has_avx2 = __builtin_cpu_supports("avx2");
+            return has_avx2;
+        }
+#endif
+
+        void FinishChunk(const PairChunk &chunk, size_t count, double *distances) {
+            double dot[BATCH_CHUNK];
+#ifdef GEO_HAS_AVX2_KERNEL
+            if (HasAvx2()) {
+                CombineAvx2(chunk, count, dot);
+            } else {
+                CombineScalar(chunk, 0, count, dot);
+            }
+#else
+            CombineScalar(chunk, 0, count, dot);
+#endif
+            for (size_t k = 0; k != count; ++k) {
+                distances[k] = chunk.same[k] ? 0 : std::acos(dot[k]) * EARTH_RADIUS;
+            }
+        }
+    } // namespace
+
     bool Coordinates::operator==(const Coordinates &other) const {
         return lat == other.lat && lng == other.lng;
     }
@@ -27,6 +90,88 @@ namespace geo {
                 * r_earth;
     }
 
+    template <>
+    double ComputeDistance<DistanceMode::EXACT>(Coordinates from, Coordinates to) {
+        return ComputeDistance(from, to);
+    }
+
+    template <>
+    double ComputeDistance<DistanceMode::HAVERSINE>(Coordinates from, Coordinates to) {
+        const double sin_half_dlat = std::sin((to.lat - from.lat) * DEG_TO_RAD / 2);
+        const double sin_half_dlng = std::sin((to.lng - from.lng) * DEG_TO_RAD / 2);
+        const double haversine = sin_half_dlat * sin_half_dlat
+                + std::cos(from.lat * DEG_TO_RAD) * std::cos(to.lat * DEG_TO_RAD) * sin_half_dlng * sin_half_dlng;
+        return 2 * EARTH_RADIUS * std::asin(std::min(1., std::sqrt(haversine)));
+    }
+
+    template <>
+    double ComputeDistance<DistanceMode::EQUIRECTANGULAR>(Coordinates from, Coordinates to) {
+        double dlng = to.lng - from.lng;
+        if (dlng > 180.) { // разность долгот через 180-й меридиан
+            dlng -= 360.;
+        } else if (dlng < -180.) {
+            dlng += 360.;
+        }
+        const double x = dlng * DEG_TO_RAD * std::cos((from.lat + to.lat) / 2 * DEG_TO_RAD);
+        const double y = (to.lat - from.lat) * DEG_TO_RAD;
+        return std::sqrt(x * x + y * y) * EARTH_RADIUS;
+    }
+
+    void PointArray::Reserve(size_t count) {
+        lat_.reserve(count);
+        lng_.reserve(count);
+        sin_lat_.reserve(count);
+        cos_lat_.reserve(count);
+    }
+
+    void PointArray::Add(Coordinates point) {
+        lat_.push_back(point.lat);
+        lng_.push_back(point.lng);
+        sin_lat_.push_back(std::sin(point.lat * DEG_TO_RAD));
+        cos_lat_.push_back(std::cos(point.lat * DEG_TO_RAD));
+    }
+
+    void ComputePathDistances(const PointArray &points, const size_t *path, size_t path_size, double *distances) {
+        if (path_size < 2) {
+            return;
+        }
+        PairChunk chunk;
+        const size_t pair_count = path_size - 1;
+        for (size_t begin = 0; begin < pair_count; begin += BATCH_CHUNK) {
+            const size_t count = std::min(BATCH_CHUNK, pair_count - begin);
+            for (size_t k = 0; k != count; ++k) {
+                const size_t a = path[begin + k];
+                const size_t b = path[begin + k + 1];
+                chunk.sin_a[k] = points.sin_lat_[a];
+                chunk.cos_a[k] = points.cos_lat_[a];
+                chunk.sin_b[k] = points.sin_lat_[b];
+                chunk.cos_b[k] = points.cos_lat_[b];
+                chunk.cos_dlng[k] = std::cos(std::abs(points.lng_[a] - points.lng_[b]) * DEG_TO_RAD);
+                chunk.same[k] = points.lat_[a] == points.lat_[b] && points.lng_[a] == points.lng_[b];
+            }
+            FinishChunk(chunk, count, distances + begin);
+        }
+    }
+
+    void ComputeDistances(Coordinates center, const PointArray &points, const size_t *indices, size_t count, double *distances) {
+        const double center_sin = std::sin(center.lat * DEG_TO_RAD);
+        const double center_cos = std::cos(center.lat * DEG_TO_RAD);
+        PairChunk chunk;
+        for (size_t begin = 0; begin < count; begin += BATCH_CHUNK) {
+            const size_t chunk_count = std::min(BATCH_CHUNK, count - begin);
+            for (size_t k = 0; k != chunk_count; ++k) {
+                const size_t b = indices[begin + k];
+                chunk.sin_a[k] = center_sin;
+                chunk.cos_a[k] = center_cos;
+                chunk.sin_b[k] = points.sin_lat_[b];
+                chunk.cos_b[k] = points.cos_lat_[b];
+                chunk.cos_dlng[k] = std::cos(std::abs(center.lng - points.lng_[b]) * DEG_TO_RAD);
+                chunk.same[k] = center.lat == points.lat_[b] && center.lng == points.lng_[b];
+            }
+            FinishChunk(chunk, chunk_count, distances + begin);
+        }
+    }
+
     bool IsZero(double value) {
         return std::abs(value) < EPSILON;
     }
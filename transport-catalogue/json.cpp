@@ -1,5 +1,19 @@
 #include "json.h"
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <system_error>
+#include <thread>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JSON_HAS_SIMD_SCAN
+#include <immintrin.h>
+#endif
+
 using namespace std::literals;
 
 namespace json {
@@ -11,347 +25,1262 @@ namespace json {
         bool IsDelimiterSymbol(const char c) {
             return (c == ',' || c == ']' || c == '}' || c == '\0' || c == '\"');
         }
-
-        void SkipSpaces(std::istream &input) {
-            char c;
-            while (input >> c && IsSpaceSymbol(c)) {
-            }
-            if (!input.eof() && !input.bad()) {
-                input.putback(c);
-            } else {
-                throw ParsingError("Unexpected end of stream"s);
-            }
+        bool IsDigit(const char c) {
+            return c >= '0' && c <= '9';
+        }
+        bool IsStructuralSymbol(const char c) {
+            return (c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',');
         }
 
-        Node LoadNode(std::istream &input);
-
-        Node LoadNull(std::istream &input) {
-            char c;
-            input >> c;
+        constexpr size_t MAX_VALUE_SIZE = UINT32_MAX; // длина строки и размер контейнера хранятся в Node в 32 битах
+        constexpr size_t SMALL_DICT_SIZE = 32;
+        constexpr size_t MAX_INDEXED_SIZE = UINT32_MAX; // позиции в индексе лексем 32-битные
 
-            if (!(input >> c) || c != 'u') {
-                throw ParsingError("Error reading literal null"s);
-            }
-            if (!(input >> c) || c != 'l') {
-                throw ParsingError("Error reading literal null"s);
-            }
-            if (!(input >> c) || c != 'l') {
-                throw ParsingError("Error reading literal null"s);
+        size_t CheckValueSize(size_t size) {
+            if (size > MAX_VALUE_SIZE) {
+                throw std::length_error("JSON value is too large");
             }
-            c = static_cast<char>(input.peek());
-            if (!(input.eof() || input.bad()) && !(IsSpaceSymbol(c) || IsDelimiterSymbol(c))) {
-                throw ParsingError("Error reading literal null"s);
-            }
-            return Node();
+            return size;
         }
 
-        Node LoadBool(std::istream &input) {
-            char c;
-            input >> c;
-            if (c == 't') { // читаем литерал true
-                if (!(input >> c) || c != 'r') {
-                    throw ParsingError("Error reading literal true"s);
-                }
-                if (!(input >> c) || c != 'u') {
-                    throw ParsingError("Error reading literal true"s);
-                }
-                if (!(input >> c) || c != 'e') {
-                    throw ParsingError("Error reading literal true"s);
-                }
-                c = static_cast<char>(input.peek());
-                if (!(input.eof() || input.bad()) && !(IsSpaceSymbol(c) || IsDelimiterSymbol(c))) {
-                    throw ParsingError("Error reading literal true"s);
-                }
-                return Node(true);
-            } else { // читаем литерал false
-                if (!(input >> c) || c != 'a') {
-                    throw ParsingError("Error reading literal false"s);
-                }
-                if (!(input >> c) || c != 'l') {
-                    throw ParsingError("Error reading literal false"s);
-                }
-                if (!(input >> c) || c != 's') {
-                    throw ParsingError("Error reading literal false"s);
-                }
-                if (!(input >> c) || c != 'e') {
-                    throw ParsingError("Error reading literal false"s);
-                }
-                c = static_cast<char>(input.peek());
-                if (!(input.eof() || input.bad()) && !(IsSpaceSymbol(c) || IsDelimiterSymbol(c))) {
-                    throw ParsingError("Error reading literal false"s);
+        /* Сортирует элементы словаря по ключу с сохранением порядка равных и удаляет повторы ключей. Возвращает новое количество */
+        size_t SortDictItems(DictItem *items, size_t count) {
+            const auto key_less = [](const DictItem &lhs, const DictItem &rhs) {
+                return lhs.first < rhs.first;
+            };
+            if (count <= SMALL_DICT_SIZE) {
+                // вставками: без дополнительного буфера, который выделяет std::stable_sort
+                for (DictItem *it = items; it != items + count; ++it) {
+                    std::rotate(std::upper_bound(items, it, *it, key_less), it, it + 1);
                 }
-                return Node(false);
+            } else {
+                std::stable_sort(items, items + count, key_less);
             }
+            return static_cast<size_t>(std::unique(items, items + count, [](const DictItem &lhs, const DictItem &rhs) {
+                                           return lhs.first == rhs.first;
+                                       }) - items);
         }
 
-        Node LoadNumber(std::istream &input) {
-            std::string parsed_num;
-
-            SkipSpaces(input);
-
-            // Считывает в parsed_num очередной символ из input
-            auto read_char = [&parsed_num, &input] {
-                parsed_num += static_cast<char>(input.get());
-                if (!input) {
-                    throw ParsingError("Error reading number from input stream"s);
-                }
-            };
+        /*
+         * Разбор лексем JSON из непрерывного буфера: указатель на текущий символ движется по буферу, без потоков и посимвольного чтения.
+         * Строки без escape-последовательностей отдаются как std::string_view прямо на буфер, строки с ними раскодируются
+         * во внутренний буфер scratch_. Числа преобразуются std::from_chars прямо из буфера.
+         * Сообщения об ошибках те же, что и у прежнего разбора из std::istream.
+         */
+        class Scanner {
+        public:
+            explicit Scanner(std::string_view text)
+                : pos_(text.data()), end_(text.data() + text.size()) {
+            }
 
-            // Считывает одну или более цифр в parsed_num из input
-            auto read_digits = [&input, read_char] {
-                if (!std::isdigit(input.peek())) {
-                    throw ParsingError("Number expected"s);
+            /* Пропускает пробельные символы и возвращает первый символ следующей лексемы, в конце буфера выбрасывает ParsingError */
+            char NextChar() {
+                while (pos_ != end_ && IsSpaceSymbol(*pos_)) {
+                    ++pos_;
                 }
-                while (std::isdigit(input.peek())) {
-                    read_char();
+                if (pos_ == end_) {
+                    throw ParsingError("Unexpected end of stream"s);
                 }
-            };
+                return *pos_;
+            }
 
-            if (input.peek() == '-') {
-                read_char();
+            /* Пропускает односимвольную лексему, возвращённую NextChar */
+            void Consume() {
+                ++pos_;
             }
-            // Парсим целую часть числа
-            if (input.peek() == '0') {
-                read_char();
-                // После 0 в JSON не могут идти другие цифры
-            } else {
-                read_digits();
+
+            /* Пропускает пробельные символы, false - в буфере больше нет лексем */
+            bool HasToken() {
+                while (pos_ != end_ && IsSpaceSymbol(*pos_)) {
+                    ++pos_;
+                }
+                return pos_ != end_;
             }
 
-            bool is_int = true;
-            // Парсим дробную часть числа
-            if (input.peek() == '.') {
-                read_char();
-                read_digits();
-                is_int = false;
+            const char *GetPosition() const {
+                return pos_;
             }
 
-            // Парсим экспоненциальную часть числа
-            if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-                read_char();
-                if (ch = input.peek(); ch == '+' || ch == '-') {
-                    read_char();
+            /* Продолжает разбор с позиции pos (за значением, разобранным отдельно) */
+            void SkipTo(const char *pos) {
+                pos_ = pos;
+            }
+
+            /* Литерал должен совпасть целиком и закончиться концом буфера, пробелом или разделителем */
+            void LoadLiteral(std::string_view literal, std::string_view error) {
+                if (static_cast<size_t>(end_ - pos_) < literal.size() || std::string_view(pos_, literal.size()) != literal) {
+                    throw ParsingError(std::string(error));
+                }
+                pos_ += literal.size();
+                if (pos_ != end_ && !(IsSpaceSymbol(*pos_) || IsDelimiterSymbol(*pos_))) {
+                    throw ParsingError(std::string(error));
                 }
-                read_digits();
-                is_int = false;
             }
 
-            try {
+            std::variant<int, double> ScanNumber() {
+                const char *number_begin = pos_;
+                if (*pos_ == '-') {
+                    ++pos_;
+                }
+                // Парсим целую часть числа, после 0 в JSON не могут идти другие цифры
+                if (pos_ != end_ && *pos_ == '0') {
+                    ++pos_;
+                } else {
+                    SkipDigits();
+                }
+
+                bool is_int = true;
+                // Парсим дробную часть числа
+                if (pos_ != end_ && *pos_ == '.') {
+                    ++pos_;
+                    SkipDigits();
+                    is_int = false;
+                }
+                // Парсим экспоненциальную часть числа
+                if (pos_ != end_ && (*pos_ == 'e' || *pos_ == 'E')) {
+                    ++pos_;
+                    if (pos_ != end_ && (*pos_ == '+' || *pos_ == '-')) {
+                        ++pos_;
+                    }
+                    SkipDigits();
+                    is_int = false;
+                }
+
+                // from_chars не принимает ведущий '+', а '-' в JSON допустим только перед числом - разбираем как есть
                 if (is_int) {
-                    // Сначала пробуем преобразовать строку в int
-                    try {
-                        return Node(std::stoi(parsed_num));
-                    } catch (...) {
-                        // В случае неудачи, например, при переполнении,
-                        // код ниже попробует преобразовать строку в double
+                    int int_value = 0;
+                    if (const auto [ptr, ec] = std::from_chars(number_begin, pos_, int_value); ec == std::errc() && ptr == pos_) {
+                        return int_value;
                     }
+                    // при переполнении int число разбирается как double
                 }
-                return Node(std::stod(parsed_num));
-            } catch (...) {
-                throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
+                double double_value = 0;
+                if (const auto [ptr, ec] = std::from_chars(number_begin, pos_, double_value); ec == std::errc() && ptr == pos_) {
+                    return double_value;
+                }
+                throw ParsingError("Failed to convert "s + std::string(number_begin, pos_) + " to number"s);
             }
-        }
 
-        // Считывает содержимое строкового литерала JSON-документа
-        // Функцию следует использовать после считывания открывающего символа ":
-        Node LoadString(std::istream &input) {
-            auto it = std::istreambuf_iterator<char>(input);
-            auto end = std::istreambuf_iterator<char>();
-            std::string s;
-            while (true) {
-                if (it == end) {
-                    // Поток закончился до того, как встретили закрывающую кавычку?
-                    throw ParsingError("String parsing error");
+            /*
+             * Считывает содержимое строкового литерала, вызывается после открывающего символа ".
+             * Результат действителен до следующего вызова ScanString
+             */
+            std::string_view ScanString() {
+                const char *chunk_begin = pos_;
+                // быстрый проход до первого символа, требующего обработки
+                while (pos_ != end_ && *pos_ != '"' && *pos_ != '\\' && *pos_ != '\n' && *pos_ != '\r') {
+                    ++pos_;
                 }
-                const char ch = *it;
-                if (ch == '"') {
-                    // Встретили закрывающую кавычку
-                    ++it;
-                    break;
-                } else if (ch == '\\') {
+                if (pos_ != end_ && *pos_ == '"') {
+                    // строка без escape-последовательностей - отдаём её прямо из буфера
+                    ++pos_;
+                    return std::string_view(chunk_begin, static_cast<size_t>(pos_ - 1 - chunk_begin));
+                }
+
+                scratch_.clear();
+                while (true) {
+                    if (pos_ == end_) {
+                        // Буфер закончился до того, как встретили закрывающую кавычку
+                        throw ParsingError("String parsing error");
+                    }
+                    const char ch = *pos_;
+                    if (ch == '"') {
+                        // Встретили закрывающую кавычку
+                        scratch_.append(chunk_begin, pos_);
+                        ++pos_;
+                        return scratch_;
+                    }
+                    if (ch == '\n' || ch == '\r') {
+                        // Строковый литерал внутри JSON не может прерываться символами \r или \n
+                        throw ParsingError("Unexpected end of line"s);
+                    }
                     // Встретили начало escape-последовательности
-                    ++it;
-                    if (it == end) {
-                        // Поток завершился сразу после символа обратной косой черты
+                    scratch_.append(chunk_begin, pos_);
+                    ++pos_;
+                    if (pos_ == end_) {
+                        // Буфер закончился сразу после символа обратной косой черты
                         throw ParsingError("String parsing error");
                     }
-                    const char escaped_char = *(it);
                     // Обрабатываем одну из последовательностей: \\, \n, \t, \r, \"
-                    switch (escaped_char) {
+                    switch (const char escaped_char = *pos_) {
                     case 'n':
-                        s.push_back('\n');
+                        scratch_.push_back('\n');
                         break;
                     case 't':
-                        s.push_back('\t');
+                        scratch_.push_back('\t');
                         break;
                     case 'r':
-                        s.push_back('\r');
+                        scratch_.push_back('\r');
                         break;
                     case '"':
-                        s.push_back('"');
+                        scratch_.push_back('"');
                         break;
                     case '\\':
-                        s.push_back('\\');
+                        scratch_.push_back('\\');
                         break;
                     default:
                         // Встретили неизвестную escape-последовательность
                         throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
                     }
-                } else if (ch == '\n' || ch == '\r') {
-                    // Строковый литерал внутри- JSON не может прерываться символами \r или \n
-                    throw ParsingError("Unexpected end of line"s);
+                    ++pos_;
+                    chunk_begin = pos_;
+                    while (pos_ != end_ && *pos_ != '"' && *pos_ != '\\' && *pos_ != '\n' && *pos_ != '\r') {
+                        ++pos_;
+                    }
+                }
+            }
+
+        protected:
+            const char *pos_;
+            const char *end_;
+
+        private:
+            void SkipDigits() {
+                if (pos_ == end_ || !IsDigit(*pos_)) {
+                    throw ParsingError("Number expected"s);
+                }
+                while (pos_ != end_ && IsDigit(*pos_)) {
+                    ++pos_;
+                }
+            }
+
+            std::string scratch_;
+        };
+
+#ifdef JSON_HAS_SIMD_SCAN
+        /*
+         * Первая стадия двухстадийного разбора: текст просматривается блоками по 64 символа, SSE2 или AVX2 сравнения дают
+         * для блока битовые маски кавычек, обратных косых черт, пробелов, переводов строк и структурных символов {}[]:,
+         * По маскам без ветвлений по символам находятся границы строк (с учётом экранированных кавычек) и собирается индекс -
+         * позиции всех лексем по возрастанию:
+         * 1) структурные символы вне строк;
+         * 2) открывающие и закрывающие кавычки строк;
+         * 3) первые символы чисел и литералов;
+         * 4) обратные косые черты и переводы строк внутри строк - такие строки вторая стадия разбирает посимвольно.
+         */
+        constexpr size_t BLOCK_SIZE = 64;    // по биту маски на символ
+        constexpr size_t INDEX_CHUNK = 1024; // позиций за одно пополнение индекса
+
+        enum class ScanMode {
+            SCALAR,
+            SSE2,
+            AVX2
+        };
+
+        struct BlockMasks {
+            uint64_t quote = 0;
+            uint64_t backslash = 0;
+            uint64_t space = 0;
+            uint64_t line_break = 0;
+            uint64_t structural = 0;
+        };
+
+        __attribute__((target("sse2")))
+        uint64_t MoveMaskSse2(__m128i bytes, size_t offset) {
+            return static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(bytes))) << offset;
+        }
+
+        /* AllTokens = false - только кавычки, обратные косые черты и скобки с запятыми (без ':'), для поиска границ элементов */
+        template <bool AllTokens>
+        __attribute__((target("sse2")))
+        BlockMasks ClassifySse2(const char *block) {
+            BlockMasks masks;
+            for (size_t offset = 0; offset != BLOCK_SIZE; offset += 16) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + offset));
+                // '[' и ']' отличаются от '{' и '}' только битом 0x20
+                const __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+                const __m128i brackets = _mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('}')));
+                masks.quote |= MoveMaskSse2(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')), offset);
+                masks.backslash |= MoveMaskSse2(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\')), offset);
+                if constexpr (AllTokens) {
+                    const __m128i line_break = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')));
+                    const __m128i space = _mm_or_si128(line_break, _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                                                                                _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))));
+                    const __m128i structural = _mm_or_si128(brackets, _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')),
+                                                                                   _mm_cmpeq_epi8(chunk, _mm_set1_epi8(','))));
+                    masks.space |= MoveMaskSse2(space, offset);
+                    masks.line_break |= MoveMaskSse2(line_break, offset);
+                    masks.structural |= MoveMaskSse2(structural, offset);
                 } else {
-                    // Просто считываем очередной символ и помещаем его в результирующую строку
-                    s.push_back(ch);
+                    masks.structural |= MoveMaskSse2(_mm_or_si128(brackets, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(','))), offset);
                 }
-                ++it;
             }
-            return Node(std::move(s));
+            return masks;
         }
 
-        Node LoadArray(std::istream &input) {
-            Array result;
-            char c;
-            for (; input >> c && c != ']';) {
-                if (IsSpaceSymbol(c)) {
-                    continue;
+        __attribute__((target("avx2")))
+        uint64_t MoveMaskAvx2(__m256i bytes, size_t offset) {
+            return static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(bytes))) << offset;
+        }
+
+        template <bool AllTokens>
+        __attribute__((target("avx2")))
+        BlockMasks ClassifyAvx2(const char *block) {
+            BlockMasks masks;
+            for (size_t offset = 0; offset != BLOCK_SIZE; offset += 32) {
+                const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + offset));
+                const __m256i lower = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+                const __m256i brackets = _mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}')));
+                masks.quote |= MoveMaskAvx2(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"')), offset);
+                masks.backslash |= MoveMaskAvx2(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\')), offset);
+                if constexpr (AllTokens) {
+                    const __m256i line_break = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')),
+                                                               _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r')));
+                    const __m256i space = _mm256_or_si256(line_break, _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')),
+                                                                                      _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))));
+                    const __m256i structural = _mm256_or_si256(brackets, _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(':')),
+                                                                                         _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(','))));
+                    masks.space |= MoveMaskAvx2(space, offset);
+                    masks.line_break |= MoveMaskAvx2(line_break, offset);
+                    masks.structural |= MoveMaskAvx2(structural, offset);
+                } else {
+                    masks.structural |= MoveMaskAvx2(_mm256_or_si256(brackets, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(','))), offset);
+                }
+            }
+            return masks;
+        }
+
+        ScanMode GetScanMode() {
+            static const ScanMode mode = __builtin_cpu_supports("avx2")   ? ScanMode::AVX2
+                                         : __builtin_cpu_supports("sse2") ? ScanMode::SSE2
+                                                                          : ScanMode::SCALAR;
+            return mode;
+        }
+
+        /*
+         * Индекс строится порциями по мере разбора: вторая стадия читает текст сразу за первой, пока он ещё в кэше,
+         * а память под индекс не зависит от размера текста.
+         * brackets_only - в индексе только скобки и запятые вне строк (для поиска границ элементов массивов, см. LoadParallel)
+         */
+        class StructuralIndexer {
+        public:
+            StructuralIndexer(std::string_view text, ScanMode mode, bool brackets_only = false)
+                : text_(text), mode_(mode), brackets_only_(brackets_only) {
+            }
+
+            /* Записывает в out следующие позиции, не меньше INDEX_CHUNK, если текст не кончился (места нужно на INDEX_CHUNK + BLOCK_SIZE).
+               Возвращает количество записанных, 0 - в конце текста */
+            size_t Fill(uint32_t *out) {
+                return mode_ == ScanMode::AVX2 ? FillAvx2(out) : FillSse2(out);
+            }
+
+        private:
+            // цикл по блокам компилируется под каждый набор инструкций, чтобы классификация блока встраивалась в него
+            __attribute__((target("avx2")))
+            size_t FillAvx2(uint32_t *out) {
+                return brackets_only_ ? FillBlocks<ClassifyAvx2<false>, false>(out) : FillBlocks<ClassifyAvx2<true>, true>(out);
+            }
+
+            __attribute__((target("sse2")))
+            size_t FillSse2(uint32_t *out) {
+                return brackets_only_ ? FillBlocks<ClassifySse2<false>, false>(out) : FillBlocks<ClassifySse2<true>, true>(out);
+            }
+
+            template <BlockMasks (*Classify)(const char *), bool AllTokens>
+            __attribute__((always_inline)) size_t FillBlocks(uint32_t *out) {
+                out_ = out;
+                count_ = 0;
+                while (count_ < INDEX_CHUNK && offset_ + BLOCK_SIZE <= text_.size()) {
+                    ProcessBlock<AllTokens>(Classify(text_.data() + offset_), offset_);
+                    offset_ += BLOCK_SIZE;
+                }
+                if (count_ < INDEX_CHUNK && offset_ < text_.size()) {
+                    // неполный последний блок дополняется пробелами - они не дают позиций в индексе
+                    char tail[BLOCK_SIZE];
+                    std::fill(std::begin(tail), std::end(tail), ' ');
+                    std::copy(text_.data() + offset_, text_.data() + text_.size(), tail);
+                    ProcessBlock<AllTokens>(Classify(tail), offset_);
+                    offset_ = text_.size();
+                }
+                return count_;
+            }
+
+            template <bool AllTokens>
+            __attribute__((always_inline)) void ProcessBlock(const BlockMasks &masks, size_t offset) {
+                const uint64_t quote = masks.quote & ~FindEscaped(masks.backslash);
+                // биты строки: от открывающей кавычки включительно до закрывающей
+                const uint64_t in_string = PrefixXor(quote) ^ in_string_carry_;
+                in_string_carry_ = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+                if constexpr (!AllTokens) {
+                    Emit(offset, masks.structural & ~in_string);
+                    return;
+                }
+                // число или литерал начинается с символа вне строки, который не пробел, не кавычка и не структурный символ,
+                // если перед ним такого же символа нет
+                const uint64_t scalar = ~(masks.structural | masks.space | quote | in_string);
+                const uint64_t scalar_start = scalar & ~(scalar << 1 | scalar_carry_);
+                scalar_carry_ = scalar >> 63;
+                Emit(offset, (masks.structural & ~in_string) | quote | scalar_start | ((masks.backslash | masks.line_break) & in_string));
+            }
+
+            /*
+             * Символы, экранированные обратной косой чертой: следующие за нечётной по счёту чертой серии.
+             * Серии, начатые с нечётного бита, сложением с маской черт переносятся за свой конец; по чётности
+             * позиции конца серии и её начала определяется, нечётна ли длина серии
+             */
+            __attribute__((always_inline)) uint64_t FindEscaped(uint64_t backslash) {
+                if (backslash == 0) {
+                    const uint64_t escaped = escape_carry_;
+                    escape_carry_ = 0;
+                    return escaped;
+                }
+                constexpr uint64_t even_bits = 0x5555555555555555ULL;
+                backslash &= ~escape_carry_; // экранированная черта не начинает новой escape-последовательности
+                const uint64_t follows_escape = backslash << 1 | escape_carry_;
+                const uint64_t odd_sequence_starts = backslash & ~even_bits & ~follows_escape;
+                uint64_t sequences_starting_on_even_bits = 0;
+                escape_carry_ = __builtin_add_overflow(odd_sequence_starts, backslash, &sequences_starting_on_even_bits) ? 1 : 0;
+                const uint64_t invert_mask = sequences_starting_on_even_bits << 1;
+                return (even_bits ^ invert_mask) & follows_escape;
+            }
+
+            /* Бит i результата - чётность числа единиц в битах 0..i */
+            static uint64_t PrefixXor(uint64_t bits) {
+                for (size_t shift = 1; shift != BLOCK_SIZE; shift *= 2) {
+                    bits ^= bits << shift;
+                }
+                return bits;
+            }
+
+            void Emit(size_t offset, uint64_t tokens) {
+                uint32_t *out = out_ + count_;
+                count_ += static_cast<size_t>(__builtin_popcountll(tokens));
+                while (tokens != 0) {
+                    *out++ = static_cast<uint32_t>(offset) + static_cast<uint32_t>(__builtin_ctzll(tokens));
+                    tokens &= tokens - 1;
                 }
-                if (c != ',') {
-                    input.putback(c);
+            }
+
+            std::string_view text_;
+            ScanMode mode_;
+            bool brackets_only_;
+            size_t offset_ = 0; // начало следующего блока
+            uint32_t *out_ = nullptr;
+            size_t count_ = 0;
+            uint64_t escape_carry_ = 0;    // 1, если блок закончился неэкранированной обратной косой чертой
+            uint64_t in_string_carry_ = 0; // все единицы, если блок закончился внутри строки
+            uint64_t scalar_carry_ = 0;    // 1, если блок закончился символом числа или литерала
+        };
+
+        /*
+         * Вторая стадия: переход к следующей лексеме - шаг по индексу, пробелы и содержимое строк не просматриваются.
+         * Строка без escape-последовательностей и переводов строк заканчивается на следующей позиции индекса,
+         * остальные строки, числа и литералы разбирает Scanner с позиции из индекса.
+         * Ошибку в тексте сообщает Scanner: при ParsingError текст разбирается им ещё раз (см. Load и Parse).
+         */
+        class IndexedScanner : public Scanner {
+        public:
+            IndexedScanner(std::string_view text, ScanMode mode)
+                : Scanner(text), begin_(text.data()), indexer_(text, mode), positions_(INDEX_CHUNK + BLOCK_SIZE) {
+            }
+
+            char NextChar() {
+                if (!HasPosition() || lost_position_) {
+                    throw ParsingError("Unexpected end of stream"s);
                 }
+                pos_ = begin_ + *next_;
+                return *pos_;
+            }
+
+            void Consume() {
+                ++pos_;
+                ++next_;
+            }
+
+            bool HasToken() {
+                return lost_position_ || HasPosition(); // при потерянной позиции ошибку сообщит NextChar
+            }
+
+            void LoadLiteral(std::string_view literal, std::string_view error) {
+                Scanner::LoadLiteral(literal, error);
+                FinishScalar();
+            }
+
+            std::variant<int, double> ScanNumber() {
+                const std::variant<int, double> number = Scanner::ScanNumber();
+                FinishScalar();
+                return number;
+            }
+
+            std::string_view ScanString() {
+                if (HasPosition() && begin_[*next_] == '"') {
+                    const char *close = begin_ + *next_;
+                    const std::string_view result(pos_, static_cast<size_t>(close - pos_));
+                    pos_ = close + 1;
+                    ++next_;
+                    return result;
+                }
+                const std::string_view result = Scanner::ScanString();
+                while (HasPosition() && begin_ + *next_ < pos_) {
+                    ++next_;
+                }
+                return result;
+            }
+
+        private:
+            bool HasPosition() {
+                if (next_ == last_) {
+                    next_ = positions_.data();
+                    last_ = next_ + indexer_.Fill(positions_.data());
+                }
+                return next_ != last_;
+            }
+
+            /*
+             * Число или литерал занимает в индексе одну позицию. Символ сразу после него, если это не пробел,
+             * должен быть в индексе, иначе индекс расходится с разбором и следующую лексему по нему не найти
+             * (для корневого значения следующая лексема не нужна, как и Scanner)
+             */
+            void FinishScalar() {
+                ++next_;
+                if (pos_ != end_ && !IsSpaceSymbol(*pos_) && !IsStructuralSymbol(*pos_) && *pos_ != '"') {
+                    lost_position_ = true;
+                }
+            }
+
+            const char *begin_;
+            StructuralIndexer indexer_;
+            std::vector<uint32_t> positions_;
+            const uint32_t *next_ = nullptr;
+            const uint32_t *last_ = nullptr;
+            bool lost_position_ = false;
+        };
 
-                result.push_back(LoadNode(input));
+        /* Разбор по индексу, если процессор поддерживает SSE2 или AVX2 */
+        bool UseIndexedScanner(std::string_view text) {
+            return GetScanMode() != ScanMode::SCALAR && text.size() <= MAX_INDEXED_SIZE;
+        }
+#endif
+
+        /* После элемента массива (словаря) ожидается ',' или закрывающая скобка. Возвращает true, если контейнер закончился */
+        template <typename Tokens>
+        bool ScanSeparator(Tokens &tokens, char close, const char *error) {
+            const char c = tokens.NextChar();
+            tokens.Consume();
+            if (c == close) {
+                return true;
             }
-            if ((input.eof() || input.bad()) && c != ']') {
-                throw ParsingError("Unexpected end of stream"s);
+            if (c != ',') {
+                throw ParsingError(error);
             }
-            return Node(std::move(result));
+            return false;
         }
 
-        Node LoadDict(std::istream &input) {
-            Dict result;
-            char c;
-            for (; input >> c && c != '}';) {
-                if (IsSpaceSymbol(c)) {
-                    continue;
+        /* Пропускает пробелы и, если контейнер пуст, его закрывающую скобку */
+        template <typename Tokens>
+        bool ScanEmptyContainer(Tokens &tokens, char close) {
+            if (tokens.NextChar() == close) {
+                tokens.Consume();
+                return true;
+            }
+            return false;
+        }
+
+        /* Ключ словаря вместе с двоеточием после него */
+        template <typename Tokens>
+        std::string_view ScanKey(Tokens &tokens) {
+            if (tokens.NextChar() != '"') {
+                throw ParsingError("Expected string key in dictionary"s);
+            }
+            tokens.Consume();
+            const std::string_view key = tokens.ScanString();
+            if (tokens.NextChar() != ':') {
+                throw ParsingError("Expected ':' after dictionary key"s);
+            }
+            tokens.Consume();
+            return key;
+        }
+
+        /*
+         * Ключи одного документа: повторяющийся ключ хранится в арене один раз, ключи из таблицы не копируются.
+         * Открытая адресация с линейным пробированием в таблице постоянного размера, которая помещается в кэш процессора:
+         * интернируются первые MAX_INTERNED_KEYS разных ключей. Часто повторяющиеся ключи (имена полей) встречаются
+         * в документе рано, а редкие (например, названия остановок в road_distances) дальше просто копируются.
+         * Ключи таблицы заносятся первыми, чтобы ключ искался одним поиском
+         */
+        class KeyInterner {
+        public:
+            KeyInterner(Arena &arena, const KeyTable *table)
+                : arena_(arena), slots_(INTERNER_SLOTS) {
+                if (table) {
+                    for (const std::string_view key : *table) {
+                        const uint32_t hash = static_cast<uint32_t>(KeyHash{}(key));
+                        if (const size_t i = FindSlot(key, hash); !key.empty() && !slots_[i].data) {
+                            Remember(i, key, hash);
+                        }
+                    }
+                }
+            }
+
+            std::string_view Intern(std::string_view key) {
+                if (key.empty()) {
+                    return {};
                 }
-                if (c == ',') {
-                    input >> c;
+                const uint32_t hash = static_cast<uint32_t>(KeyHash{}(key));
+                const size_t i = FindSlot(key, hash);
+                if (slots_[i].data) {
+                    return {slots_[i].data, slots_[i].size};
                 }
+                const std::string_view copy = arena_.CopyString(key);
+                Remember(i, copy, hash);
+                return copy;
+            }
+
+        private:
+            static constexpr size_t INTERNER_SLOTS = 1024;                  // степень двойки
+            static constexpr size_t MAX_INTERNED_KEYS = INTERNER_SLOTS / 2; // при заполнении до половины цепочки пробирования коротки
+
+            struct Slot {
+                const char *data = nullptr; // nullptr - свободная ячейка
+                uint32_t size = 0;
+                uint32_t hash = 0;
+            };
+
+            /* Ячейка с ключом key или свободная ячейка, в которую его можно занести */
+            size_t FindSlot(std::string_view key, uint32_t hash) const {
+                size_t i = hash & (INTERNER_SLOTS - 1);
+                while (slots_[i].data && !(slots_[i].hash == hash && std::string_view(slots_[i].data, slots_[i].size) == key)) {
+                    i = (i + 1) & (INTERNER_SLOTS - 1);
+                }
+                return i;
+            }
 
-                std::string key = LoadString(input).AsString();
-                input >> c;
-                result.insert({std::move(key), LoadNode(input)});
+            void Remember(size_t i, std::string_view key, uint32_t hash) {
+                if (count_ < MAX_INTERNED_KEYS && key.size() <= MAX_VALUE_SIZE) {
+                    slots_[i] = {key.data(), static_cast<uint32_t>(key.size()), hash};
+                    ++count_;
+                }
             }
-            if ((input.eof() || input.bad()) && c != '}') {
-                throw ParsingError("Unexpected end of stream"s);
+
+            Arena &arena_;
+            std::vector<Slot> slots_;
+            size_t count_ = 0;
+        };
+
+        /* Массив, разобранный отдельно от остального текста: [open, close] - его скобки в тексте */
+        struct SplicedArray {
+            const char *open = nullptr;
+            const char *close = nullptr;
+            Node node;
+        };
+
+        /*
+         * Разбор в дерево Node (Document). Элементы незаконченных массивов (словарей) копятся в общих стеках values_ (items_),
+         * по закрывающей скобке копируются в арену одним куском и снимаются со стека.
+         * Лексемы читает Tokens - Scanner или IndexedScanner.
+         * Массивы [splices, splices_end) (по порядку в тексте, только для Scanner) уже разобраны: встретив '[' одного из них,
+         * парсер берёт готовый Node и продолжает разбор за его закрывающей скобкой.
+         */
+        template <typename Tokens>
+        class Parser {
+        public:
+            Parser(Tokens tokens, Arena &arena, const KeyTable *keys, const SplicedArray *splices = nullptr, const SplicedArray *splices_end = nullptr)
+                : tokens_(std::move(tokens)), arena_(arena), keys_(arena, keys), splice_(splices), splices_end_(splices_end) {
             }
-            return Node(std::move(result));
+
+            Node LoadNode() {
+                const char c = tokens_.NextChar();
+                if (c == '[') {
+                    if constexpr (std::is_same_v<Tokens, Scanner>) {
+                        if (splice_ != splices_end_ && tokens_.GetPosition() == splice_->open) {
+                            tokens_.SkipTo(splice_->close + 1);
+                            return (splice_++)->node;
+                        }
+                    }
+                    tokens_.Consume();
+                    return LoadArray();
+                } else if (c == '{') {
+                    tokens_.Consume();
+                    return LoadDict();
+                } else if (c == '"') {
+                    tokens_.Consume();
+                    return Node(arena_, tokens_.ScanString());
+                } else if (c == 'n') {
+                    tokens_.LoadLiteral("null"sv, "Error reading literal null"sv);
+                    return Node();
+                } else if (c == 't') {
+                    tokens_.LoadLiteral("true"sv, "Error reading literal true"sv);
+                    return Node(true);
+                } else if (c == 'f') {
+                    tokens_.LoadLiteral("false"sv, "Error reading literal false"sv);
+                    return Node(false);
+                } else {
+                    return std::visit([](auto value) { return Node(value); }, tokens_.ScanNumber());
+                }
+            }
+
+            /* Кусок массива без скобок: "значение, значение, ...". В пустом куске нет элементов */
+            std::vector<Node> LoadElements() {
+                std::vector<Node> result;
+                if (!tokens_.HasToken()) {
+                    return result;
+                }
+                while (true) {
+                    result.push_back(LoadNode());
+                    if (!tokens_.HasToken()) {
+                        return result;
+                    }
+                    if (tokens_.NextChar() != ',') {
+                        throw ParsingError("Expected ',' or ']' in array");
+                    }
+                    tokens_.Consume();
+                }
+            }
+
+            /* Все ли отдельно разобранные массивы встретились при разборе */
+            bool IsSpliced() const {
+                return splice_ == splices_end_;
+            }
+
+        private:
+            Node LoadArray() {
+                const size_t first = values_.size();
+                if (!ScanEmptyContainer(tokens_, ']')) {
+                    do {
+                        Node value = LoadNode();
+                        values_.push_back(value);
+                    } while (!ScanSeparator(tokens_, ']', "Expected ',' or ']' in array"));
+                }
+                const Node result(arena_, values_.data() + first, values_.size() - first);
+                values_.resize(first);
+                return result;
+            }
+
+            Node LoadDict() {
+                const size_t first = items_.size();
+                if (!ScanEmptyContainer(tokens_, '}')) {
+                    do {
+                        // ключ может лежать во временном буфере разбора строк, поэтому сразу заменяется интернированным
+                        const std::string_view key = keys_.Intern(ScanKey(tokens_));
+                        Node value = LoadNode();
+                        items_.emplace_back(key, value);
+                    } while (!ScanSeparator(tokens_, '}', "Expected ',' or '}' in dictionary"));
+                }
+                // элементы собираются в порядке текста и сортируются по ключу один раз
+                const Node result(arena_, items_.data() + first, items_.size() - first);
+                items_.resize(first);
+                return result;
+            }
+
+            Tokens tokens_;
+            Arena &arena_;
+            KeyInterner keys_;
+            std::vector<Node> values_;
+            std::vector<DictItem> items_;
+            const SplicedArray *splice_;
+            const SplicedArray *splices_end_;
+        };
+
+        /* Разбор с передачей событий обработчику, без построения дерева */
+        template <typename Tokens>
+        class EventParser {
+        public:
+            EventParser(Tokens tokens, Handler &handler)
+                : tokens_(std::move(tokens)), handler_(handler) {
+            }
+
+            void ParseValue() {
+                const char c = tokens_.NextChar();
+                if (c == '[') {
+                    tokens_.Consume();
+                    ParseArray();
+                } else if (c == '{') {
+                    tokens_.Consume();
+                    ParseDict();
+                } else if (c == '"') {
+                    tokens_.Consume();
+                    handler_.String(tokens_.ScanString());
+                } else if (c == 'n') {
+                    tokens_.LoadLiteral("null"sv, "Error reading literal null"sv);
+                    handler_.Null();
+                } else if (c == 't') {
+                    tokens_.LoadLiteral("true"sv, "Error reading literal true"sv);
+                    handler_.Bool(true);
+                } else if (c == 'f') {
+                    tokens_.LoadLiteral("false"sv, "Error reading literal false"sv);
+                    handler_.Bool(false);
+                } else if (const std::variant<int, double> number = tokens_.ScanNumber(); std::holds_alternative<int>(number)) {
+                    handler_.Int(std::get<int>(number));
+                } else {
+                    handler_.Double(std::get<double>(number));
+                }
+            }
+
+        private:
+            void ParseArray() {
+                handler_.StartArray();
+                if (!ScanEmptyContainer(tokens_, ']')) {
+                    do {
+                        ParseValue();
+                    } while (!ScanSeparator(tokens_, ']', "Expected ',' or ']' in array"));
+                }
+                handler_.EndArray();
+            }
+
+            void ParseDict() {
+                handler_.StartDict();
+                if (!ScanEmptyContainer(tokens_, '}')) {
+                    do {
+                        handler_.Key(ScanKey(tokens_));
+                        ParseValue();
+                    } while (!ScanSeparator(tokens_, '}', "Expected ',' or '}' in dictionary"));
+                }
+                handler_.EndDict();
+            }
+
+            Tokens tokens_;
+            Handler &handler_;
+        };
+
+        /* Обработчик, пропускающий события: разбор только ради проверки текста */
+        class NullHandler final : public Handler {
+        public:
+            void Null() override {
+            }
+            void Bool(bool) override {
+            }
+            void Int(int) override {
+            }
+            void Double(double) override {
+            }
+            void String(std::string_view) override {
+            }
+            void Key(std::string_view) override {
+            }
+            void StartArray() override {
+            }
+            void EndArray() override {
+            }
+            void StartDict() override {
+            }
+            void EndDict() override {
+            }
+        };
+
+        constexpr size_t MIN_SPLIT_ARRAY_SIZE = 64 * 1024; // меньшие массивы разбираются вместе с остальным текстом
+        constexpr size_t MIN_CHUNK_SIZE = 256 * 1024;      // кусок массива, ради которого стоит запускать поток
+        constexpr size_t CHUNKS_PER_THREAD = 4;             // кусков больше, чем потоков, - потоки заканчивают почти одновременно
+
+        /* Массив верхнего уровня: позиции скобок и запятых между элементами */
+        struct TopLevelArray {
+            size_t open = 0;
+            size_t close = 0; // 0 - массив не закончился
+            std::vector<size_t> commas;
+        };
+
+        /*
+         * Поиск массивов верхнего уровня - корневого массива или массивов - значений корневого словаря.
+         * Получает по порядку структурные символы вне строк, следит только за глубиной вложенности.
+         * Для текста с ошибкой границы могут оказаться неверными - это обнаружит разбор кусков
+         */
+        class TopLevelArrayFinder {
+        public:
+            /* Возвращает false, когда корневое значение закончилось */
+            bool Add(size_t pos, char c) {
+                if (c == '[' || c == '{') {
+                    ++depth_;
+                    if (depth_ == 1) {
+                        array_depth_ = c == '[' ? 1 : 2;
+                    }
+                    if (c == '[' && depth_ == array_depth_) {
+                        arrays_.push_back({pos, 0, {}});
+                    }
+                } else if (c == ']' || c == '}') {
+                    if (depth_ == array_depth_ && !arrays_.empty() && arrays_.back().close == 0) {
+                        if (c != ']') {
+                            arrays_.clear(); // скобки не парные - текст разберёт последовательный парсер
+                            return false;
+                        }
+                        arrays_.back().close = pos;
+                    }
+                    if (depth_ <= 1) {
+                        return false;
+                    }
+                    --depth_;
+                } else if (c == ',' && depth_ == array_depth_ && !arrays_.empty() && arrays_.back().close == 0) {
+                    arrays_.back().commas.push_back(pos);
+                }
+                return true;
+            }
+
+            std::vector<TopLevelArray> Extract() {
+                if (!arrays_.empty() && arrays_.back().close == 0) {
+                    arrays_.pop_back();
+                }
+                return std::move(arrays_);
+            }
+
+        private:
+            size_t depth_ = 0;
+            size_t array_depth_ = 0;
+            std::vector<TopLevelArray> arrays_;
+        };
+
+        std::vector<TopLevelArray> FindTopLevelArrays(std::string_view text) {
+            TopLevelArrayFinder finder;
+#ifdef JSON_HAS_SIMD_SCAN
+            if (UseIndexedScanner(text)) {
+                StructuralIndexer indexer(text, GetScanMode(), true);
+                std::vector<uint32_t> positions(INDEX_CHUNK + BLOCK_SIZE);
+                while (const size_t count = indexer.Fill(positions.data())) {
+                    for (size_t i = 0; i != count; ++i) {
+                        if (!finder.Add(positions[i], text[positions[i]])) {
+                            return finder.Extract();
+                        }
+                    }
+                }
+                return finder.Extract();
+            }
+#endif
+            for (size_t pos = 0; pos < text.size(); ++pos) {
+                const char c = text[pos];
+                if (c == '"') {
+                    // пропуск строки вместе с экранированными символами
+                    for (++pos; pos < text.size() && text[pos] != '"'; ++pos) {
+                        if (text[pos] == '\\') {
+                            ++pos;
+                        }
+                    }
+                } else if (IsStructuralSymbol(c) && !finder.Add(pos, c)) {
+                    break;
+                }
+            }
+            return finder.Extract();
         }
 
-        Node LoadNode(std::istream &input) {
-            char c;
+        /* Кусок массива верхнего уровня между запятыми (или скобкой и запятой) */
+        struct ArrayChunk {
+            size_t array = 0;
+            std::string_view text;
+            std::vector<Node> elements;
+        };
 
-            SkipSpaces(input);
-            input >> c;
+        std::vector<Node> LoadArrayChunk(std::string_view text, Arena &arena, const KeyTable *keys) {
+#ifdef JSON_HAS_SIMD_SCAN
+            if (UseIndexedScanner(text)) {
+                return Parser(IndexedScanner(text, GetScanMode()), arena, keys).LoadElements();
+            }
+#endif
+            return Parser(Scanner(text), arena, keys).LoadElements();
+        }
 
-            if (c == '[') {
-                return LoadArray(input);
-            } else if (c == '{') {
-                return LoadDict(input);
-            } else if (c == '"') {
-                return LoadString(input);
-            } else if (c == 'n') {
-                input.putback(c);
-                return LoadNull(input);
-            } else if (c == 't' || c == 'f') {
-                input.putback(c);
-                return LoadBool(input);
-            } else {
-                input.putback(c);
-                return LoadNumber(input);
+        /* Делит массивы на куски не короче chunk_size по запятым между элементами */
+        std::vector<ArrayChunk> SplitArrays(std::string_view text, const std::vector<TopLevelArray> &arrays, size_t chunk_size) {
+            std::vector<ArrayChunk> chunks;
+            for (size_t array_idx = 0; array_idx != arrays.size(); ++array_idx) {
+                const TopLevelArray &array = arrays[array_idx];
+                size_t begin = array.open + 1;
+                for (const size_t comma : array.commas) {
+                    if (comma - begin >= chunk_size) {
+                        chunks.push_back({array_idx, text.substr(begin, comma - begin), {}});
+                        begin = comma + 1;
+                    }
+                }
+                chunks.push_back({array_idx, text.substr(begin, array.close - begin), {}});
+            }
+            return chunks;
+        }
+
+        /*
+         * Параллельный разбор: куски массивов верхнего уровня разбирают потоки, каждый в свою арену, затем остальной текст
+         * разбирается в первую арену, а массивы собираются из элементов кусков. std::nullopt - разобрать текст последовательно
+         * (текст с ошибкой: сообщение о ней должно быть тем же, что у Load)
+         */
+        std::optional<Document> TryLoadParallel(std::string_view text, const KeyTable *keys, size_t threads_num) {
+            std::vector<TopLevelArray> arrays = FindTopLevelArrays(text);
+            arrays.erase(std::remove_if(arrays.begin(), arrays.end(),
+                                        [](const TopLevelArray &array) { return array.close - array.open < MIN_SPLIT_ARRAY_SIZE; }),
+                         arrays.end());
+            size_t split_size = 0;
+            for (const TopLevelArray &array : arrays) {
+                split_size += array.close - array.open;
+            }
+            threads_num = std::min(threads_num, split_size / MIN_CHUNK_SIZE);
+            if (threads_num <= 1) {
+                return std::nullopt;
+            }
+            std::vector<ArrayChunk> chunks = SplitArrays(text, arrays, split_size / (threads_num * CHUNKS_PER_THREAD));
+
+            std::vector<std::unique_ptr<Arena>> arenas;
+            for (size_t i = 0; i != threads_num; ++i) {
+                arenas.push_back(std::make_unique<Arena>());
+            }
+            // куски раздаются потокам по очереди, элементы куска лежат в арене разобравшего его потока
+            std::atomic<size_t> next_chunk{0};
+            std::atomic<bool> failed{false};
+            auto load_chunks = [&](size_t thread_idx) {
+                try {
+                    for (size_t idx = next_chunk++; idx < chunks.size() && !failed; idx = next_chunk++) {
+                        chunks[idx].elements = LoadArrayChunk(chunks[idx].text, *arenas[thread_idx], keys);
+                    }
+                } catch (...) {
+                    failed = true; // любую ошибку (и нехватку памяти) повторит и сообщит последовательный разбор
+                }
+            };
+            std::vector<std::thread> workers;
+            workers.reserve(threads_num - 1);
+            for (size_t thread_idx = 1; thread_idx != threads_num; ++thread_idx) {
+                workers.emplace_back(load_chunks, thread_idx);
+            }
+            load_chunks(0);
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+            if (failed) {
+                return std::nullopt;
+            }
+
+            Arena &arena = *arenas.front();
+            std::vector<SplicedArray> splices;
+            splices.reserve(arrays.size());
+            std::vector<Node> elements;
+            for (auto chunk = chunks.begin(); chunk != chunks.end();) {
+                const size_t array_idx = chunk->array;
+                const bool is_split = std::next(chunk) != chunks.end() && std::next(chunk)->array == array_idx;
+                elements.clear();
+                for (; chunk != chunks.end() && chunk->array == array_idx; ++chunk) {
+                    if (chunk->elements.empty() && is_split) {
+                        return std::nullopt; // пустой элемент между запятыми
+                    }
+                    elements.insert(elements.end(), chunk->elements.begin(), chunk->elements.end());
+                }
+                const TopLevelArray &array = arrays[array_idx];
+                splices.push_back({text.data() + array.open, text.data() + array.close, Node(arena, elements.data(), elements.size())});
+            }
+
+            try {
+                Parser parser(Scanner(text), arena, keys, splices.data(), splices.data() + splices.size());
+                const Node root = parser.LoadNode();
+                if (!parser.IsSpliced()) {
+                    return std::nullopt;
+                }
+                return Document(root, std::move(arenas));
+            } catch (const ParsingError &) {
+                return std::nullopt;
             }
         }
 
     } // namespace
 
+    std::string_view Arena::CopyString(std::string_view value) {
+        if (value.empty()) {
+            return {};
+        }
+        char *data = Allocate<char>(value.size());
+        std::copy(value.begin(), value.end(), data);
+        return {data, value.size()};
+    }
+
+    const Node &Array::at(size_t index) const {
+        if (index >= size_) {
+            throw std::out_of_range("Array index out of range");
+        }
+        return data_[index];
+    }
+
+    Dict::const_iterator Dict::find(std::string_view key) const {
+        const const_iterator it = std::lower_bound(begin(), end(), key, [](const DictItem &item, std::string_view value) {
+            return item.first < value;
+        });
+        return it != end() && it->first == key ? it : end();
+    }
+
+    const Node &Dict::at(std::string_view key) const {
+        const const_iterator it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("Key not found in Dict");
+        }
+        return it->second;
+    }
+
+    Dict::const_iterator Dict::find(InternedKey key) const {
+        const std::string_view value = key.AsString();
+        // словари небольшие, просмотр подряд со сравнением адресов дешевле двоичного поиска по строкам
+        for (const DictItem &item : *this) {
+            if (item.first.data() == value.data() && item.first.size() == value.size()) {
+                return &item;
+            }
+        }
+        return find(value);
+    }
+
+    const Node &Dict::at(InternedKey key) const {
+        const const_iterator it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("Key not found in Dict");
+        }
+        return it->second;
+    }
+
+    size_t KeyHash::operator()(std::string_view key) const {
+        uint64_t head = 0;
+        uint64_t tail = 0;
+        if (key.size() >= sizeof(uint64_t)) {
+            std::memcpy(&head, key.data(), sizeof(head));
+            std::memcpy(&tail, key.data() + key.size() - sizeof(tail), sizeof(tail));
+        } else if (!key.empty()) {
+            std::memcpy(&head, key.data(), key.size());
+        }
+        uint64_t hash = (head ^ (tail * 0x9E3779B97F4A7C15ULL) ^ key.size()) * 0xFF51AFD7ED558CCDULL;
+        return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+
+    KeyTable::KeyTable(std::initializer_list<std::string_view> keys) {
+        for (const std::string_view key : keys) {
+            if (!keys_.count(key)) {
+                keys_.insert(arena_.CopyString(key));
+            }
+        }
+    }
+
+    InternedKey KeyTable::Get(std::string_view key) const {
+        const auto it = keys_.find(key);
+        if (it == keys_.end()) {
+            throw std::out_of_range("Key not found in KeyTable");
+        }
+        return InternedKey(*it);
+    }
+
+    std::optional<std::string_view> KeyTable::Find(std::string_view key) const {
+        if (const auto it = keys_.find(key); it != keys_.end()) {
+            return *it;
+        }
+        return std::nullopt;
+    }
+
+    Node::Node(Arena &arena, std::string_view val)
+        : type_(Type::STRING), size_(static_cast<uint32_t>(CheckValueSize(val.size()))), string_(arena.CopyString(val).data()) {
+    }
+
+    Node::Node(Arena &arena, const Node *items, size_t count)
+        : type_(Type::ARRAY), size_(static_cast<uint32_t>(CheckValueSize(count))) {
+        Node *data = count ? arena.Allocate<Node>(count) : nullptr;
+        std::uninitialized_copy(items, items + count, data);
+        array_ = data;
+    }
+
+    Node::Node(Arena &arena, DictItem *items, size_t count)
+        : type_(Type::DICT) {
+        count = SortDictItems(items, count);
+        size_ = static_cast<uint32_t>(CheckValueSize(count));
+        DictItem *data = count ? arena.Allocate<DictItem>(count) : nullptr;
+        std::uninitialized_copy(items, items + count, data);
+        dict_ = data;
+    }
+
     bool Node::IsInt() const {
-        return std::holds_alternative<int>(value_);
+        return type_ == Type::INT;
     }
     bool Node::IsDouble() const {
         return IsPureDouble() || IsInt();
     }
     bool Node::IsPureDouble() const {
-        return std::holds_alternative<double>(value_);
+        return type_ == Type::DOUBLE;
     }
     bool Node::IsBool() const {
-        return std::holds_alternative<bool>(value_);
+        return type_ == Type::BOOL;
     }
     bool Node::IsString() const {
-        return std::holds_alternative<std::string>(value_);
+        return type_ == Type::STRING;
     }
     bool Node::IsNull() const {
-        return std::holds_alternative<std::nullptr_t>(value_);
+        return type_ == Type::NULL_VALUE;
     }
     bool Node::IsArray() const {
-        return std::holds_alternative<Array>(value_);
+        return type_ == Type::ARRAY;
     }
     bool Node::IsMap() const {
-        return std::holds_alternative<Dict>(value_);
+        return type_ == Type::DICT;
     }
 
     int Node::AsInt() const {
         if (IsInt()) {
-            return std::get<int>(value_);
+            return int_;
         } else {
             throw std::logic_error("Not integer");
         }
     }
     bool Node::AsBool() const {
         if (IsBool()) {
-            return std::get<bool>(value_);
+            return bool_;
         } else {
             throw std::logic_error("Not boolean");
         }
     }
     double Node::AsDouble() const {
         if (IsPureDouble()) {
-            return std::get<double>(value_);
+            return double_;
         } else if (IsInt()) {
-            return static_cast<double>(std::get<int>(value_));
+            return static_cast<double>(int_);
         } else {
             throw std::logic_error("Not double");
         }
     }
-    const std::string &Node::AsString() const {
+    std::string_view Node::AsString() const {
         if (IsString()) {
-            return std::get<std::string>(value_);
+            return {string_, size_};
         } else {
             throw std::logic_error("Not string");
         }
     }
-    const Array &Node::AsArray() const {
+    Array Node::AsArray() const {
         if (IsArray()) {
-            return std::get<Array>(value_);
+            return {array_, size_};
         } else {
             throw std::logic_error("Not Array");
         }
     }
-    const Dict &Node::AsMap() const {
+    Dict Node::AsMap() const {
         if (IsMap()) {
-            return std::get<Dict>(value_);
+            return {dict_, size_};
         } else {
             throw std::logic_error("Not Map");
         }
     }
 
+    bool Node::operator==(const Node &rhs) const {
+        if (type_ != rhs.type_) {
+            return false;
+        }
+        switch (type_) {
+        case Type::NULL_VALUE:
+            return true;
+        case Type::BOOL:
+            return bool_ == rhs.bool_;
+        case Type::INT:
+            return int_ == rhs.int_;
+        case Type::DOUBLE:
+            return double_ == rhs.double_;
+        case Type::STRING:
+            return AsString() == rhs.AsString();
+        case Type::ARRAY:
+            return AsArray() == rhs.AsArray();
+        case Type::DICT:
+            return AsMap() == rhs.AsMap();
+        }
+        return false;
+    }
+
+    bool operator==(const Array &lhs, const Array &rhs) {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+
+    bool operator==(const Dict &lhs, const Dict &rhs) {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+
     std::ostream &operator<<(std::ostream &output, const Node &node) {
-        PrintNode(node, PrintContext{output});
+        Writer(output).Write(node);
         return output;
     }
 
     std::ostream &operator<<(std::ostream &output, const Array &value) {
-        PrintValue(value, PrintContext{output});
+        Writer writer(output);
+        writer.StartArray();
+        for (const Node &node : value) {
+            writer.Write(node);
+        }
+        writer.EndArray();
         return output;
     }
 
@@ -363,86 +1292,387 @@ namespace json {
         return !(left == right);
     }
 
-    Document Load(std::istream &input) {
-        return Document{LoadNode(input)};
+    std::string ReadStream(std::istream &input) {
+        std::string text;
+        char chunk[64 * 1024];
+        while (const std::streamsize read_count = input.rdbuf()->sgetn(chunk, sizeof(chunk))) {
+            text.append(chunk, static_cast<size_t>(read_count));
+        }
+        return text;
+    }
+
+    Document Load(std::istream &input, const KeyTable *keys) {
+        return Load(std::string_view(ReadStream(input)), keys);
+    }
+
+    Document Load(std::string_view text, const KeyTable *keys) {
+#ifdef JSON_HAS_SIMD_SCAN
+        if (UseIndexedScanner(text)) {
+            try {
+                auto arena = std::make_unique<Arena>();
+                const Node root = Parser(IndexedScanner(text, GetScanMode()), *arena, keys).LoadNode();
+                return Document(root, std::move(arena));
+            } catch (const ParsingError &) {
+                // текст с ошибкой разбирается ещё раз без индекса, чтобы сообщение об ошибке было тем же
+            }
+        }
+#endif
+        auto arena = std::make_unique<Arena>();
+        const Node root = Parser(Scanner(text), *arena, keys).LoadNode();
+        return Document(root, std::move(arena));
     }
 
-    void PrintString(const std::string &value, std::ostream &out) {
-        out << "\""sv;
-        for (const char c : value) {
-            if (c == '\\' || c == '\"') {
-                out << '\\';
-                out << c;
+    Document LoadParallel(std::string_view text, const KeyTable *keys, size_t threads_num) {
+        if (threads_num == 0) {
+            threads_num = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        if (threads_num > 1 && text.size() >= 2 * MIN_CHUNK_SIZE) {
+            if (std::optional<Document> document = TryLoadParallel(text, keys, threads_num)) {
+                return std::move(*document);
+            }
+        }
+        return Load(text, keys);
+    }
+
+    void Parse(std::string_view text, Handler &handler) {
+#ifdef JSON_HAS_SIMD_SCAN
+        if (UseIndexedScanner(text)) {
+            try {
+                EventParser(IndexedScanner(text, GetScanMode()), handler).ParseValue();
+            } catch (const ParsingError &) {
+                // часть событий обработчик уже получил, повторный разбор без индекса нужен только ради сообщения об ошибке
+                NullHandler null_handler;
+                EventParser(Scanner(text), null_handler).ParseValue();
+                throw;
+            }
+            return;
+        }
+#endif
+        EventParser(Scanner(text), handler).ParseValue();
+    }
+
+    void NodeHandler::Null() {
+        AddValue(Node());
+    }
+    void NodeHandler::Bool(bool value) {
+        AddValue(Node(value));
+    }
+    void NodeHandler::Int(int value) {
+        AddValue(Node(value));
+    }
+    void NodeHandler::Double(double value) {
+        AddValue(Node(value));
+    }
+    void NodeHandler::String(std::string_view value) {
+        AddValue(Node(arena_, value));
+    }
+    void NodeHandler::Key(std::string_view key) {
+        if (key_table_) {
+            if (const std::optional<std::string_view> interned = key_table_->Find(key)) {
+                keys_.push_back(*interned);
+                return;
+            }
+        }
+        keys_.push_back(arena_.CopyString(key));
+    }
+    void NodeHandler::StartArray() {
+        containers_.push_back({false, values_.size()});
+    }
+    void NodeHandler::EndArray() {
+        const size_t first = containers_.back().first;
+        const Node array(arena_, values_.data() + first, values_.size() - first);
+        values_.resize(first);
+        containers_.pop_back();
+        AddValue(array);
+    }
+    void NodeHandler::StartDict() {
+        containers_.push_back({true, items_.size()});
+    }
+    void NodeHandler::EndDict() {
+        const size_t first = containers_.back().first;
+        const Node dict(arena_, items_.data() + first, items_.size() - first);
+        items_.resize(first);
+        containers_.pop_back();
+        AddValue(dict);
+    }
+
+    bool NodeHandler::IsComplete() const {
+        return result_.has_value();
+    }
+
+    Node NodeHandler::Extract() {
+        if (!result_) {
+            throw std::logic_error("Unfinished arrays and dictionaries / Незаконченные массивы и словари");
+        }
+        const Node result = *result_;
+        result_.reset();
+        return result;
+    }
+
+    void NodeHandler::AddValue(Node value) {
+        if (containers_.empty()) {
+            result_ = value;
+        } else if (containers_.back().is_dict) {
+            items_.emplace_back(keys_.back(), value);
+            keys_.pop_back();
+        } else {
+            values_.push_back(value);
+        }
+    }
+
+    Writer::Writer(std::ostream &output, Format format)
+        : output_(output), format_(format), buffer_(new char[BUFFER_SIZE]) {
+    }
+
+    Writer::~Writer() {
+        Flush();
+    }
+
+    void Writer::Null() {
+        BeforeValue();
+        Append("null"sv);
+    }
+
+    void Writer::Bool(bool value) {
+        BeforeValue();
+        Append(value ? "true"sv : "false"sv);
+    }
+
+    void Writer::Int(int value) {
+        BeforeValue();
+        char chars[16];
+        const auto [end, ec] = std::to_chars(std::begin(chars), std::end(chars), value);
+        Append(std::string_view(chars, static_cast<size_t>(end - chars)));
+    }
+
+    void Writer::Double(double value) {
+        BeforeValue();
+        char chars[32]; // кратчайшая запись double не длиннее 24 символов
+        const auto [end, ec] = std::to_chars(std::begin(chars), std::end(chars), value);
+        Append(std::string_view(chars, static_cast<size_t>(end - chars)));
+    }
+
+    void Writer::String(std::string_view value) {
+        BeforeValue();
+        WriteString(value);
+    }
+
+    void Writer::StartString() {
+        BeforeValue();
+        Put('"');
+    }
+
+    void Writer::StringPart(std::string_view part) {
+        WriteEscaped(part);
+    }
+
+    void Writer::EndString() {
+        Put('"');
+    }
+
+    void Writer::RawValue(std::string_view json) {
+        BeforeValue();
+        Append(json);
+    }
+
+    void Writer::Key(std::string_view key) {
+        NextItem();
+        WriteString(key);
+        if (format_ == Format::PRETTY) {
+            Append(": "sv);
+        } else {
+            Put(':');
+        }
+    }
+
+    void Writer::StartArray() {
+        StartContainer('[', false);
+    }
+
+    void Writer::EndArray() {
+        EndContainer(']');
+    }
+
+    void Writer::StartDict() {
+        StartContainer('{', true);
+    }
+
+    void Writer::EndDict() {
+        EndContainer('}');
+    }
+
+    void Writer::Write(const Node &node) {
+        switch (node.GetType()) {
+        case Node::Type::NULL_VALUE:
+            Null();
+            break;
+        case Node::Type::BOOL:
+            Bool(node.AsBool());
+            break;
+        case Node::Type::INT:
+            Int(node.AsInt());
+            break;
+        case Node::Type::DOUBLE:
+            Double(node.AsDouble());
+            break;
+        case Node::Type::STRING:
+            String(node.AsString());
+            break;
+        case Node::Type::ARRAY:
+            StartArray();
+            for (const Node &item : node.AsArray()) {
+                Write(item);
+            }
+            EndArray();
+            break;
+        case Node::Type::DICT:
+            StartDict();
+            for (const auto &[key, value] : node.AsMap()) {
+                Key(key);
+                Write(value);
+            }
+            EndDict();
+            break;
+        }
+    }
+
+    void Writer::Flush() {
+        output_.write(buffer_.get(), static_cast<std::streamsize>(size_));
+        size_ = 0;
+    }
+
+    void Writer::Append(std::string_view text) {
+        if (text.size() > BUFFER_SIZE - size_) {
+            Flush();
+            if (text.size() >= BUFFER_SIZE) {
+                // длинный кусок идёт в поток напрямую, без копирования в буфер
+                output_.write(text.data(), static_cast<std::streamsize>(text.size()));
+                return;
+            }
+        }
+        std::copy(text.begin(), text.end(), buffer_.get() + size_);
+        size_ += text.size();
+    }
+
+    void Writer::WriteString(std::string_view value) {
+        Put('"');
+        WriteEscaped(value);
+        Put('"');
+    }
+
+    /* Экранируются только \\, ", \n, \t и \r: остальные символы копируются кусками между ними */
+    void Writer::WriteEscaped(std::string_view value) {
+        size_t run_begin = 0;
+        for (size_t pos = 0; pos != value.size(); ++pos) {
+            const char c = value[pos];
+            char escaped = 0;
+            if (c == '\\' || c == '"') {
+                escaped = c;
             } else if (c == '\n') {
-                out << "\\n"sv;
+                escaped = 'n';
             } else if (c == '\t') {
-                out << "\\t"sv;
+                escaped = 't';
             } else if (c == '\r') {
-                out << "\\r"sv;
+                escaped = 'r';
             } else {
-                out << c;
+                continue;
             }
+            Append(value.substr(run_begin, pos - run_begin));
+            Put('\\');
+            Put(escaped);
+            run_begin = pos + 1;
         }
-        out << "\""sv;
+        Append(value.substr(run_begin));
     }
 
-    void PrintValue(std::nullptr_t, const PrintContext &ctx) {
-        ctx.out << "null"sv;
+    void Writer::NextItem() {
+        Container &container = containers_.back();
+        if (!container.empty) {
+            Put(',');
+        }
+        container.empty = false;
+        if (format_ == Format::PRETTY) {
+            Put('\n');
+            for (size_t i = 0; i != containers_.size() * INDENT_STEP; ++i) {
+                Put(' ');
+            }
+        }
     }
-    void PrintValue(const Array &value, const PrintContext &ctx) {
-        std::ostream &out = ctx.out;
-        bool first_time = true;
-        out << "[\n"sv;
-        auto next_ctx = ctx.Indented();
 
-        for (const Node &node : value) {
-            if (!first_time) {
-                out << ",\n"sv;
-            } else {
-                first_time = false;
-            }
-            next_ctx.PrintIndent();
-            PrintNode(node, next_ctx);
+    void Writer::BeforeValue() {
+        // значение словаря идёт сразу за ключом, разделитель выведен перед ключом
+        if (!containers_.empty() && !containers_.back().is_dict) {
+            NextItem();
         }
-        out.put('\n');
-        ctx.PrintIndent();
-        out.put(']');
     }
-    void PrintValue(const Dict &value, const PrintContext &ctx) {
-        std::ostream &out = ctx.out;
-        bool first_time = true;
-        out << "{\n"sv;
-        auto next_ctx = ctx.Indented();
 
-        for (const auto& [key, node] : value) {
-            if (!first_time) {
-                out << ",\n"sv;
-            } else {
-                first_time = false;
+    void Writer::StartContainer(char open, bool is_dict) {
+        BeforeValue();
+        Put(open);
+        containers_.push_back({is_dict, true});
+    }
+
+    void Writer::EndContainer(char close) {
+        const bool empty = containers_.back().empty;
+        containers_.pop_back();
+        if (format_ == Format::PRETTY) {
+            // пустой контейнер выводится, как у прежнего Print: скобки через пустую строку
+            Put('\n');
+            if (empty) {
+                Put('\n');
+            }
+            for (size_t i = 0; i != containers_.size() * INDENT_STEP; ++i) {
+                Put(' ');
             }
-            next_ctx.PrintIndent();
-            PrintString(key, ctx.out);
-            out << ": "sv;
-            PrintNode(node, next_ctx);
         }
-        out.put('\n');
-        ctx.PrintIndent();
-        out.put('}');
+        Put(close);
+    }
+
+    StringStreamBuffer::StringStreamBuffer(Writer &writer)
+        : writer_(writer) {
+        setp(buffer_, buffer_ + BUFFER_SIZE);
+    }
+
+    StringStreamBuffer::~StringStreamBuffer() {
+        PassToWriter();
+    }
+
+    StringStreamBuffer::int_type StringStreamBuffer::overflow(int_type c) {
+        PassToWriter();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
     }
-    void PrintValue(const bool value, const PrintContext &ctx) {
-        ctx.out << (value ? "true"sv : "false"sv);
+
+    std::streamsize StringStreamBuffer::xsputn(const char *s, std::streamsize n) {
+        const size_t count = static_cast<size_t>(n);
+        if (count <= static_cast<size_t>(epptr() - pptr())) {
+            std::copy(s, s + count, pptr());
+            pbump(static_cast<int>(count));
+        } else {
+            // не помещающийся кусок экранируется сразу из памяти вызывающего
+            PassToWriter();
+            writer_.StringPart(std::string_view(s, count));
+        }
+        return n;
     }
 
-    void PrintValue(const std::string value, const PrintContext &ctx) {
-        PrintString(value, ctx.out);
+    int StringStreamBuffer::sync() {
+        PassToWriter();
+        return 0;
     }
 
-    void Print(const Document &doc, std::ostream &output) {
-        PrintNode(doc.GetRoot(), PrintContext{output});
+    void StringStreamBuffer::PassToWriter() {
+        if (pptr() != pbase()) {
+            writer_.StringPart(std::string_view(pbase(), static_cast<size_t>(pptr() - pbase())));
+            setp(buffer_, buffer_ + BUFFER_SIZE);
+        }
     }
 
-    void PrintNode(const Node &node, const PrintContext &ctx) {
-        std::visit([&ctx](const auto &value) { PrintValue(value, ctx); }, node.GetValue());
+    void Print(const Document &doc, std::ostream &output) {
+        Writer(output).Write(doc.GetRoot());
     }
 
 } // namespace json
\ No newline at end of file
@@ -4,12 +4,18 @@
  * Класс Node должен хранить значения одного из следующих типов:
  * 1) Целые числа типа int.
  * 2) Вещественные числа типа double.
- * 3) Строки — тип std::string.
+ * 3) Строки — std::string_view на символы в арене документа.
  * 4) Логический тип bool.
- * 5) Массивы: using Array = std::vector<Node>;
- * 6) Словари: using Dict = std::map<std::string, Node>;
+ * 5) Массивы: json::Array - вид на непрерывный массив Node в арене документа;
+ * 6) Словари: json::Dict - вид на отсортированный по ключам массив пар (ключ, Node) в арене документа,
+ * порядок обхода тот же, что у std::map, ключ ищется двоичным поиском по std::string_view без создания строки;
  * 7) std::nullptr_t. В C++ значение nullptr имеет тип std::nullptr_t. Используется, чтобы представить значение null в JSON документе.
  *
+ * Node - компактное значение с тегом типа (16 байт): число, bool или указатель и длина. Строки, массивы и словари
+ * лежат в монотонной арене (json::Arena), которой владеет Document. Node на них только ссылается, поэтому копируется
+ * дёшево и действителен, пока жива арена. Разрушение документа - одно освобождение арены, без обхода дерева.
+ * Строки, массивы и словари создаются конструкторами Node(Arena&, ...), которые копируют данные в арену.
+ *
  * Следующие методы Node сообщают, хранится ли внутри значение некоторого типа:
  * 1) bool IsInt() const;
  * 2) bool IsDouble() const; Возвращает true, если в Node хранится int либо double.
@@ -26,17 +32,44 @@
  * 2) bool AsBool() const;
  * 3) double AsDouble() const;. Возвращает значение типа double, если внутри хранится double либо int.
  * В последнем случае возвращается приведённое в double значение.
- * 4) const std::string& AsString() const;
- * 5) const Array& AsArray() const;
- * 6) const Map& AsMap() const;
+ * 4) std::string_view AsString() const;
+ * 5) Array AsArray() const;
+ * 6) Dict AsMap() const;
  * Объекты Node можно сравнивать между собой при помощи == и !=. Значения равны, если внутри них значения имеют одинаковый тип и содержимое.
  *
  * Валидные JSON-документы должны успешно проходить загрузку. При загрузке невалидных JSON-документов должно выбрасываться исключение json::ParsingError.
+ * Загрузка идёт из непрерывного буфера (Load(std::string_view)), например, отображённого в память файла.
+ * Load(std::istream&) сначала читает поток целиком в буфер.
+ * На процессорах с SSE2 или AVX2 разбор двухстадийный: сначала векторными сравнениями строится индекс позиций лексем,
+ * затем по нему без просмотра пробелов и содержимого строк собираются Node (или события для Handler).
+ * Без этих расширений (и для текста с ошибкой, ради прежнего сообщения) текст разбирается посимвольно.
+ * LoadParallel разбирает большие массивы верхнего уровня (base_requests, stat_requests) параллельно: границы их элементов
+ * находит предварительный просмотр структурных символов вне строк, куски массивов разбираются в потоках, каждый в свою арену,
+ * и собираются по порядку в массив документа.
+ *
+ * Разбор без построения дерева (Parse): парсер сообщает обработчику json::Handler о каждом значении, ключе словаря,
+ * начале и конце массива или словаря в порядке их следования в тексте. Строки и ключи передаются как std::string_view,
+ * действительный только во время вызова обработчика. Ошибки разбора те же, что и у Load.
+ * NodeHandler собирает из событий обычный Node - так часть документа можно разобрать событиями, а часть - в дерево.
+ *
+ * Ключи словарей интернируются: при загрузке (Load) одинаковые ключи документа хранятся в арене один раз.
+ * Ключи из таблицы json::KeyTable, переданной в Load или NodeHandler, не копируются вовсе - документ ссылается
+ * на строки таблицы, и поиск по дескриптору ключа (Dict::find(InternedKey)) сравнивает адреса, а не строки.
  */
 
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -44,41 +77,203 @@ namespace json {
 
     class Node;
 
-    using Dict = std::map<std::string, Node>;
-    using Array = std::vector<Node>;
+    using DictItem = std::pair<std::string_view, Node>;
 
     class ParsingError : public std::runtime_error {
     public:
         using runtime_error::runtime_error;
     };
 
+    /*
+     * Монотонная арена: память выделяется подряд из крупных блоков и освобождается только вся сразу -
+     * в деструкторе или методом Release. Объекты в арене не разрушаются, поэтому в ней хранятся только
+     * тривиально разрушаемые типы (символы строк, Node, DictItem).
+     */
+    class Arena {
+    public:
+        Arena() = default;
+        /* Сначала память берётся из buffer (например, массива на стеке), после Release - снова с начала buffer */
+        Arena(void *buffer, size_t size)
+            : resource_(buffer, size) {
+        }
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        template <typename T>
+        T *Allocate(size_t count) {
+            static_assert(std::is_trivially_destructible_v<T>, "Arena does not run destructors");
+            return static_cast<T *>(resource_.allocate(count * sizeof(T), alignof(T)));
+        }
+
+        std::string_view CopyString(std::string_view value);
+
+        void Release() {
+            resource_.release();
+        }
+
+    private:
+        std::pmr::monotonic_buffer_resource resource_;
+    };
+
+    /* Быстрая хеш-функция для коротких ключей словарей: длина и первые и последние 8 символов */
+    struct KeyHash {
+        size_t operator()(std::string_view key) const;
+    };
+
+    /* Дескриптор ключа из KeyTable: у ключей таблицы постоянные адреса, поэтому дескрипторы сравниваются по адресу */
+    class InternedKey {
+    public:
+        std::string_view AsString() const {
+            return value_;
+        }
+
+        bool operator==(InternedKey rhs) const {
+            return value_.data() == rhs.value_.data();
+        }
+        bool operator!=(InternedKey rhs) const {
+            return !(*this == rhs);
+        }
+
+    private:
+        friend class KeyTable;
+        explicit InternedKey(std::string_view value)
+            : value_(value) {
+        }
+
+        std::string_view value_;
+    };
+
+    /*
+     * Таблица заранее известных ключей словарей. Заполняется при создании и больше не меняется, поэтому её можно
+     * читать из нескольких потоков сразу. Документ, загруженный с таблицей, ссылается на её строки вместо своих копий,
+     * поэтому таблица должна жить дольше документа
+     */
+    class KeyTable {
+    public:
+        using const_iterator = std::unordered_set<std::string_view, KeyHash>::const_iterator;
+
+        KeyTable(std::initializer_list<std::string_view> keys);
+        KeyTable(const KeyTable &) = delete;
+        KeyTable &operator=(const KeyTable &) = delete;
+
+        /* Дескриптор ключа, если ключа нет в таблице - std::out_of_range */
+        InternedKey Get(std::string_view key) const;
+        /* Строка ключа из таблицы */
+        std::optional<std::string_view> Find(std::string_view key) const;
+
+        const_iterator begin() const {
+            return keys_.begin();
+        }
+        const_iterator end() const {
+            return keys_.end();
+        }
+
+    private:
+        Arena arena_;
+        std::unordered_set<std::string_view, KeyHash> keys_;
+    };
+
+    /* Массив документа: вид на непрерывный массив Node в арене */
+    class Array {
+    public:
+        using const_iterator = const Node *;
+
+        Array() = default;
+        Array(const Node *data, size_t size)
+            : data_(data), size_(size) {
+        }
+
+        const_iterator begin() const {
+            return data_;
+        }
+        const_iterator end() const;
+        size_t size() const {
+            return size_;
+        }
+        bool empty() const {
+            return size_ == 0;
+        }
+        const Node &operator[](size_t index) const;
+        const Node &at(size_t index) const;
+
+    private:
+        const Node *data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    /* Словарь документа: вид на массив пар (ключ, Node) в арене, отсортированный по ключу, ключи не повторяются */
+    class Dict {
+    public:
+        using const_iterator = const DictItem *;
+
+        Dict() = default;
+        Dict(const DictItem *data, size_t size)
+            : data_(data), size_(size) {
+        }
+
+        const_iterator begin() const {
+            return data_;
+        }
+        const_iterator end() const;
+        size_t size() const {
+            return size_;
+        }
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        const_iterator find(std::string_view key) const;
+        size_t count(std::string_view key) const {
+            return find(key) != end() ? 1 : 0;
+        }
+        const Node &at(std::string_view key) const;
+
+        /* Поиск по дескриптору: ключи документа, загруженного с той же таблицей, сравниваются по адресу,
+           иначе (документ собран без таблицы) - обычный поиск по строке */
+        const_iterator find(InternedKey key) const;
+        size_t count(InternedKey key) const {
+            return find(key) != end() ? 1 : 0;
+        }
+        const Node &at(InternedKey key) const;
+
+    private:
+        const DictItem *data_ = nullptr;
+        size_t size_ = 0;
+    };
+
     class Node final {
     public:
-        friend class Builder;
-        using Value = std::variant<std::nullptr_t, Array, Dict, bool, int, double, std::string>;
+        /* Простое значение - то, что можно задать без арены (см. json::Builder) */
+        using Value = std::variant<std::nullptr_t, bool, int, double, std::string_view>;
+
+        enum class Type : uint8_t {
+            NULL_VALUE,
+            BOOL,
+            INT,
+            DOUBLE,
+            STRING,
+            ARRAY,
+            DICT
+        };
 
         Node() = default;
-        Node(std::nullptr_t)
-            : value_(nullptr) {
+        Node(std::nullptr_t) {
         }
         Node(int val)
-            : value_(val) {
+            : type_(Type::INT), int_(val) {
         }
         Node(double val)
-            : value_(val) {
-        }
-        Node(std::string val)
-            : value_(std::move(val)) {
-        }
-        Node(Array val)
-            : value_(std::move(val)) {
-        }
-        Node(Dict val)
-            : value_(std::move(val)) {
+            : type_(Type::DOUBLE), double_(val) {
         }
         Node(bool val)
-            : value_(val) {
+            : type_(Type::BOOL), bool_(val) {
         }
+        /* Строка копируется в арену */
+        Node(Arena &arena, std::string_view val);
+        /* Элементы массива копируются в арену */
+        Node(Arena &arena, const Node *items, size_t count);
+        /* Элементы словаря сортируются по ключу на месте и копируются в арену, из повторяющихся ключей остаётся первый */
+        Node(Arena &arena, DictItem *items, size_t count);
 
         bool IsInt() const;
         bool IsDouble() const;
@@ -92,79 +287,267 @@ namespace json {
         int AsInt() const;
         bool AsBool() const;
         double AsDouble() const;
-        const std::string &AsString() const;
-        const Array &AsArray() const;
-        const Dict &AsMap() const;
+        std::string_view AsString() const;
+        Array AsArray() const;
+        Dict AsMap() const;
 
-        const Value &GetValue() const {
-            return value_;
-        }
-        bool operator==(const Node &rhs) const {
-            return value_ == rhs.value_;
+        Type GetType() const {
+            return type_;
         }
 
+        bool operator==(const Node &rhs) const;
+
     private:
-        Value &GetValue() {
-            return value_;
-        }
-        Value value_;
+        Type type_ = Type::NULL_VALUE;
+        uint32_t size_ = 0; // длина строки, количество элементов массива или словаря
+        union {
+            bool bool_;
+            int int_;
+            double double_;
+            const char *string_ = nullptr;
+            const Node *array_;
+            const DictItem *dict_;
+        };
     };
 
     inline bool operator!=(const Node &lhs, const Node &rhs) {
         return !(lhs == rhs);
     }
 
+    inline Array::const_iterator Array::end() const {
+        return data_ + size_;
+    }
+    inline const Node &Array::operator[](size_t index) const {
+        return data_[index];
+    }
+    inline Dict::const_iterator Dict::end() const {
+        return data_ + size_;
+    }
+
+    bool operator==(const Array &lhs, const Array &rhs);
+    bool operator==(const Dict &lhs, const Dict &rhs);
+
     std::ostream &operator<<(std::ostream &output, const Node &node);
     std::ostream &operator<<(std::ostream &output, const Array &value);
 
     class Document {
     public:
-        explicit Document(Node root) : root_(std::move(root)) {}
+        /* Документ владеет ареной, в которой лежат строки, массивы и словари root (для простого значения арена не нужна) */
+        explicit Document(Node root, std::unique_ptr<Arena> arena = nullptr)
+            : root_(root) {
+            if (arena) {
+                arenas_.push_back(std::move(arena));
+            }
+        }
+        /* Документ, части которого разобраны в разные арены (см. LoadParallel) */
+        Document(Node root, std::vector<std::unique_ptr<Arena>> arenas)
+            : arenas_(std::move(arenas)), root_(root) {
+        }
 
         const Node &GetRoot() const {
             return root_;
         }
 
     private:
+        std::vector<std::unique_ptr<Arena>> arenas_;
         Node root_;
     };
 
     inline bool operator==(const Document &left, const Document &right);
     inline bool operator!=(const Document &left, const Document &right);
 
-    Document Load(std::istream &input);
+    Document Load(std::istream &input, const KeyTable *keys = nullptr);
 
-    // Контекст вывода, хранит ссылку на поток вывода и текущий отступ
-    struct PrintContext {
-        std::ostream &out;
-        int indent_step = 4;
-        int indent = 0;
+    /* Буфер должен жить только во время разбора: строки копируются в арену документа, ключи из keys - не копируются */
+    Document Load(std::string_view text, const KeyTable *keys = nullptr);
 
-        void PrintIndent() const {
-            for (int i = 0; i != indent; ++i) {
-                out.put(' ');
-            }
+    /*
+     * То же, что Load, но большие массивы верхнего уровня (корневой массив или массивы - значения корневого словаря)
+     * разбираются кусками в threads_num потоках (0 - по числу ядер). Документ тот же, что и у Load; для небольшого текста
+     * и для текста с ошибкой (ради того же сообщения) разбор последовательный
+     */
+    Document LoadParallel(std::string_view text, const KeyTable *keys = nullptr, size_t threads_num = 0);
+
+    /* Читает поток целиком */
+    std::string ReadStream(std::istream &input);
+
+    /* Обработчик событий разбора JSON */
+    class Handler {
+    public:
+        virtual ~Handler() = default;
+
+        virtual void Null() = 0;
+        virtual void Bool(bool value) = 0;
+        virtual void Int(int value) = 0;
+        virtual void Double(double value) = 0;
+        virtual void String(std::string_view value) = 0;
+        virtual void Key(std::string_view key) = 0;
+        virtual void StartArray() = 0;
+        virtual void EndArray() = 0;
+        virtual void StartDict() = 0;
+        virtual void EndDict() = 0;
+    };
+
+    /* Разбирает одно значение JSON из text, передавая события handler */
+    void Parse(std::string_view text, Handler &handler);
+
+    /*
+     * Собирает Node из событий разбора, строки, массивы и словари - в арене arena, ключи из keys берутся из таблицы.
+     * Остальные ключи копируются в арену без интернирования: арену между значениями могут освобождать.
+     * Готовый узел забирается методом Extract, после чего обработчик можно использовать снова
+     */
+    class NodeHandler final : public Handler {
+    public:
+        explicit NodeHandler(Arena &arena, const KeyTable *keys = nullptr)
+            : arena_(arena), key_table_(keys) {
         }
 
-        // Возвращает новый контекст вывода с увеличенным смещением
-        PrintContext Indented() const {
-            return {out, indent_step, indent_step + indent};
+        void Null() override;
+        void Bool(bool value) override;
+        void Int(int value) override;
+        void Double(double value) override;
+        void String(std::string_view value) override;
+        void Key(std::string_view key) override;
+        void StartArray() override;
+        void EndArray() override;
+        void StartDict() override;
+        void EndDict() override;
+
+        /* true, если очередное значение собрано полностью */
+        bool IsComplete() const;
+        Node Extract();
+
+    private:
+        void AddValue(Node value);
+
+        /* Незаконченный массив или словарь: его элементы лежат в values_ (items_) начиная с first */
+        struct Container {
+            bool is_dict;
+            size_t first;
+        };
+
+        Arena &arena_;
+        const KeyTable *key_table_;
+        std::vector<Container> containers_;
+        std::vector<Node> values_;
+        std::vector<DictItem> items_;
+        std::vector<std::string_view> keys_; // ключи, для которых ещё не получено значение
+        std::optional<Node> result_;
+    };
+
+    /*
+     * Буферизованный вывод JSON: текст собирается в буфере и уходит в поток крупными вызовами write -
+     * при заполнении буфера, в Flush и в деструкторе.
+     * 1) Format::PRETTY - значения с новой строки с отступом 4 пробела на уровень (как у Print), Format::COMPACT - без пробелов.
+     * 2) Символы строки, которые не нужно экранировать, копируются в буфер кусками, а не по одному.
+     * 3) Числа форматируются std::to_chars, double - в кратчайшем виде, который читается обратно в то же значение
+     * (целое значение - без дробной части: 6, а не 6.0).
+     * Значения задаются событиями json::Handler (Writer можно передать в Parse) или целиком методом Write.
+     * Порядок событий должен быть согласован: ключ только в словаре, за ключом значение, End* для каждого Start*.
+     */
+    class Writer final : public Handler {
+    public:
+        enum class Format {
+            PRETTY,
+            COMPACT
+        };
+
+        explicit Writer(std::ostream &output, Format format = Format::PRETTY);
+        Writer(const Writer &) = delete;
+        Writer &operator=(const Writer &) = delete;
+        ~Writer() override;
+
+        void Null() override;
+        void Bool(bool value) override;
+        void Int(int value) override;
+        void Double(double value) override;
+        void String(std::string_view value) override;
+        void Key(std::string_view key) override;
+        void StartArray() override;
+        void EndArray() override;
+        void StartDict() override;
+        void EndDict() override;
+
+        void Write(const Node &node);
+
+        Format GetFormat() const {
+            return format_;
+        }
+
+        /*
+         * Значение-строка по частям: StartString, любое число StringPart, EndString.
+         * Части экранируются сразу в буфер, так что длинный текст не нужно заранее собирать в одну строку
+         */
+        void StartString();
+        void StringPart(std::string_view part);
+        void EndString();
+
+        /* Готовый текст JSON-значения (например, закэшированный) выводится как есть, без проверки */
+        void RawValue(std::string_view json);
+
+        /* Отдаёт накопленный текст потоку */
+        void Flush();
+
+    private:
+        static constexpr size_t BUFFER_SIZE = 64 * 1024;
+        static constexpr size_t INDENT_STEP = 4;
+
+        struct Container {
+            bool is_dict = false;
+            bool empty = true;
+        };
+
+        void Put(char c) {
+            if (size_ == BUFFER_SIZE) {
+                Flush();
+            }
+            buffer_[size_++] = c;
         }
+        void Append(std::string_view text);
+        void WriteString(std::string_view value);
+        void WriteEscaped(std::string_view text);
+        /* Разделитель перед элементом массива (словаря) и перевод строки с отступом */
+        void NextItem();
+        void BeforeValue();
+        void StartContainer(char open, bool is_dict);
+        void EndContainer(char close);
+
+        std::ostream &output_;
+        Format format_;
+        std::unique_ptr<char[]> buffer_;
+        size_t size_ = 0;
+        std::vector<Container> containers_;
     };
 
-    void Print(const Document &doc, std::ostream &output);
+    /*
+     * Буфер std::ostream, который выводит всё записанное в поток частями строки Writer (см. Writer::StartString).
+     * Так текст, который умеет выводить себя только в std::ostream (например, svg::Document), попадает в JSON
+     * за один проход по байтам, без промежуточной std::string.
+     * StartString и EndString вызывает владелец: буфер только передаёт части, последнюю - в sync или деструкторе.
+     */
+    class StringStreamBuffer final : public std::streambuf {
+    public:
+        explicit StringStreamBuffer(Writer &writer);
+        StringStreamBuffer(const StringStreamBuffer &) = delete;
+        StringStreamBuffer &operator=(const StringStreamBuffer &) = delete;
+        ~StringStreamBuffer() override;
 
-    template <typename Value>
-    void PrintValue(const Value &value, const PrintContext &ctx) {
-        ctx.out << value;
-    }
+    protected:
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char *s, std::streamsize n) override;
+        int sync() override;
+
+    private:
+        static constexpr size_t BUFFER_SIZE = 4 * 1024;
 
-    void PrintValue(std::nullptr_t, const PrintContext &ctx);
-    void PrintValue(const Array &value, const PrintContext &ctx);
-    void PrintValue(const Dict &value, const PrintContext &ctx);
-    void PrintValue(const bool value, const PrintContext &ctx);
-    void PrintValue(const std::string value, const PrintContext &ctx);
+        /* Передаёт накопленное в буфере потока Writer и освобождает буфер */
+        void PassToWriter();
 
-    void PrintNode(const Node &node, const PrintContext &ctx);
+        Writer &writer_;
+        char buffer_[BUFFER_SIZE];
+    };
+
+    /* Вывод в формате Writer::Format::PRETTY */
+    void Print(const Document &doc, std::ostream &output);
 
-} // namespace json
\ No newline at end of file
+} // namespace json
@@ -1,157 +1,282 @@
 #include "json_builder.h"
 
+#include <sstream>
+#include <type_traits>
+#include <variant>
+
 namespace json {
 
-    void Builder::ThrowIfReadyObject(std::string func_name) {
-        if (nodes_stack_.empty()) {
+    namespace {
+        /* Ошибки порядка вызовов, общие для Builder и StreamBuilder */
+        [[noreturn]] void ThrowReadyObject(const std::string &func_name) {
             std::string err_str = "Calling method " + func_name + " on a ready object / Вызов метода " + func_name + " при готовом объекте";
             throw std::logic_error(err_str);
         }
+
+        [[noreturn]] void ThrowValueWithoutKey(const std::string &func_name) {
+            const std::string in_dict = func_name == "Value()" ? " in Dict" : " inside the Dict";
+            throw std::logic_error("Calling " + func_name + in_dict + " without the previous Key() call / Вызов метода " + func_name
+                                   + " в Dict без предыдущего вызова Key()");
+        }
+
+        [[noreturn]] void ThrowKeyAfterKey() {
+            throw std::logic_error("Calling Key() immediately after the previous Key() call / Вызов метода Key() сразу после предыдущего вызова Key()");
+        }
+
+        [[noreturn]] void ThrowKeyOutsideDict() {
+            throw std::logic_error("Calling Key() method not for Dict / Вызов метода Key() не для словаря");
+        }
+
+        [[noreturn]] void ThrowEndDictForWrongContainer() {
+            throw std::logic_error("Calling EndDict() method for wrong container / Вызов EndDict() не для контейнера Dict");
+        }
+
+        [[noreturn]] void ThrowEndArrayForWrongContainer() {
+            throw std::logic_error("Calling EndArray() method for wrong container / Вызов EndArray() не для контейнера Array");
+        }
+    } // namespace
+
+    void Builder::ThrowIfReadyObject(std::string func_name) {
+        if (root_.has_value()) {
+            ThrowReadyObject(func_name);
+        }
     }
 
-    Builder::Builder() {
-        nodes_stack_.emplace_back(&root_);
+    void Builder::CheckValueContext(const std::string &func_name) const {
+        if (!containers_.empty() && containers_.back().is_dict && !last_key_.has_value()) {
+            ThrowValueWithoutKey(func_name);
+        }
+    }
+
+    void Builder::AddValue(Node value) {
+        if (containers_.empty()) {
+            root_ = value;
+        } else if (containers_.back().is_dict) {
+            items_.emplace_back(*last_key_, value);
+            last_key_.reset();
+        } else {
+            values_.push_back(value);
+        }
     }
 
-    KeyContext Builder::Key(const std::string &key) {
+    Builder::Builder()
+        : arena_(std::make_unique<Arena>()) {
+    }
+
+    KeyContext Builder::Key(std::string_view key) {
         ThrowIfReadyObject("Key()");
 
-        if (nodes_stack_.back()->IsMap()) {
+        if (!containers_.empty() && containers_.back().is_dict) {
             if(!last_key_.has_value()) {
-                std::get<Dict>(nodes_stack_.back()->GetValue())[key];
-                last_key_ = key;
+                last_key_ = arena_->CopyString(key);
             } else {
-                throw std::logic_error("Calling Key() immediately after the previous Key() call / Вызов метода Key() сразу после предыдущего вызова Key()");
+                ThrowKeyAfterKey();
             }
         } else {
-            throw std::logic_error("Calling Key() method not for Dict / Вызов метода Key() не для словаря");
+            ThrowKeyOutsideDict();
         }
         return *this;
     }
-    Builder &Builder::Value(Node::Value &&value) {
+    Builder &Builder::Value(Node::Value value) {
         ThrowIfReadyObject("Value()");
+        CheckValueContext("Value()");
 
-        if (nodes_stack_.back()->IsArray()) {
-            Node temp_node;
-            temp_node.GetValue() = value;
-            std::get<Array>(nodes_stack_.back()->GetValue()).emplace_back(temp_node);
-            return *this;
-        }
-        if (nodes_stack_.back()->IsMap()) {
-            Dict &temp = std::get<Dict>(nodes_stack_.back()->GetValue());
-            if (last_key_.has_value() && (temp.count(last_key_.value()) > 0)) {
-                temp.at(last_key_.value()).GetValue() = value;
-                last_key_.reset();
-                return *this;
+        std::visit([this](auto simple_value) {
+            if constexpr (std::is_same_v<decltype(simple_value), std::string_view>) {
+                AddValue(Node(*arena_, simple_value));
             } else {
-                throw std::logic_error("Calling Value() in Dict without the previous Key() call / Вызов метода Value() в Dict без предыдущего вызова Key()");
+                AddValue(Node(simple_value));
             }
-        }
-        nodes_stack_.back()->GetValue() = value;
-        nodes_stack_.pop_back();
+        }, value);
+        return *this;
+    }
+    Builder &Builder::StringValue(const StringWriter &write) {
+        ThrowIfReadyObject("StringValue()");
+        CheckValueContext("StringValue()");
 
+        std::ostringstream out;
+        write(out);
+        AddValue(Node(*arena_, std::string_view(out.str())));
         return *this;
     }
     DictItemContext Builder::StartDict() {
         ThrowIfReadyObject("StartDict()");
+        CheckValueContext("StartDict()");
 
-        if(nodes_stack_.back()->IsArray()) {
-            auto &temp_node = std::get<Array>(nodes_stack_.back()->GetValue()).emplace_back(Node{Dict{}});
-            nodes_stack_.emplace_back(&temp_node);
-        } else if (nodes_stack_.back()->IsMap()) {
-            Dict &dict_temp = std::get<Dict>(nodes_stack_.back()->GetValue());
-            if ((last_key_.has_value()) && (dict_temp.count(last_key_.value()) > 0)) {
-                auto &temp_node = dict_temp.at(last_key_.value()) = std::move(Node{Dict{}});
-                nodes_stack_.emplace_back(&temp_node);
-                last_key_.reset();
-            } else {
-                throw std::logic_error("Calling StartDict() inside the Dict without the previous Key() call / Вызов метода StartDict() в Dict без предыдущего вызова Key()");
-            }
-        } else if (nodes_stack_.back()->IsNull()) {
-            nodes_stack_.back()->GetValue() = Dict{};
-        }
+        containers_.push_back({true, items_.size(), last_key_});
+        last_key_.reset();
         return *this;
     }
     Builder &Builder::EndDict() {
         ThrowIfReadyObject("EndDict()");
-        if (!(nodes_stack_.back()->IsMap())) {
-            throw std::logic_error("Calling EndDict() method for wrong container / Вызов EndDict() не для контейнера Dict");
+        if (containers_.empty() || !containers_.back().is_dict) {
+            ThrowEndDictForWrongContainer();
+        }
+        if (last_key_.has_value()) {
+            // ключ без значения, как и раньше, остаётся в словаре со значением null
+            items_.emplace_back(*last_key_, Node());
         }
-        nodes_stack_.pop_back();
+        const Container container = containers_.back();
+        const Node dict(*arena_, items_.data() + container.first, items_.size() - container.first);
+        items_.resize(container.first);
+        containers_.pop_back();
+        last_key_ = container.key;
+        AddValue(dict);
         return *this;
     }
     ArrayItemContext Builder::StartArray() {
         ThrowIfReadyObject("StartArray()");
+        CheckValueContext("StartArray()");
 
-        if (nodes_stack_.back()->IsArray()) {
-            auto &temp_node = std::get<Array>(nodes_stack_.back()->GetValue()).emplace_back(Node{Array{}});
-            nodes_stack_.emplace_back(&temp_node);
-        } else if (nodes_stack_.back()->IsMap()) {
-            Dict &temp_dict = std::get<Dict>(nodes_stack_.back()->GetValue());
-            if ((last_key_.has_value()) && (temp_dict.count(last_key_.value()) > 0)) {
-                auto &temp_node = temp_dict.at(last_key_.value()) = std::move(Node{Array{}});
-                nodes_stack_.emplace_back(&temp_node);
-                last_key_.reset();
-            } else {
-                throw std::logic_error("Calling StartArray() inside the Dict without the previous Key() call / Вызов метода StartArray() в Dict без предыдущего вызова Key()");
-            }
-        } else if (nodes_stack_.back()->IsNull()) {
-            nodes_stack_.back()->GetValue() = Array{};
-            return *this;
-        }
+        containers_.push_back({false, values_.size(), last_key_});
+        last_key_.reset();
         return *this;
     }
     Builder &Builder::EndArray() {
         ThrowIfReadyObject("EndArray()");
-        if (!(nodes_stack_.back()->IsArray())) {
-            throw std::logic_error("Calling EndArray() method for wrong container / Вызов EndArray() не для контейнера Array");
+        if (containers_.empty() || containers_.back().is_dict) {
+            ThrowEndArrayForWrongContainer();
         }
-        nodes_stack_.pop_back();
+        const Container container = containers_.back();
+        const Node array(*arena_, values_.data() + container.first, values_.size() - container.first);
+        values_.resize(container.first);
+        containers_.pop_back();
+        last_key_ = container.key;
+        AddValue(array);
         return *this;
     }
-    Node &Builder::Build() {
-        if(!nodes_stack_.empty()) {
+    Document Builder::Build() {
+        if (!root_.has_value()) {
             throw std::logic_error("Unfinished arrays and dictionaries / Незаконченные массивы и словари");
         }
-        return root_;
+        if (!arena_) {
+            throw std::logic_error("Calling Build() twice / Повторный вызов метода Build()");
+        }
+        return Document(*root_, std::move(arena_));
     }
 
-    /* --------------------------- Context ------------------------------- */
+    /* --------------------------- StreamBuilder ------------------------------- */
 
-    KeyContext BaseContext::Key(std::string key) {
-        return builder_.Key(key);
+    void StreamBuilder::ThrowIfReadyObject(const std::string &func_name) const {
+        if (ready_) {
+            ThrowReadyObject(func_name);
+        }
     }
 
-    Builder &BaseContext::Value(Node::Value value) {
-        return builder_.Value(std::move(value));
+    void StreamBuilder::CheckValueContext(const std::string &func_name) const {
+        if (!containers_.empty() && containers_.back() && !has_key_) {
+            ThrowValueWithoutKey(func_name);
+        }
     }
 
-    DictValueContext KeyContext::Value(Node::Value value) {
-        return builder_.Value(std::move(value));
+    void StreamBuilder::AfterValue() {
+        has_key_ = false;
+        ready_ = containers_.empty();
     }
 
-    ArrayItemContext ArrayItemContext::Value(Node::Value value) {
-        return builder_.Value(std::move(value));
+    StreamKeyContext StreamBuilder::Key(std::string_view key) {
+        ThrowIfReadyObject("Key()");
+        if (containers_.empty() || !containers_.back()) {
+            ThrowKeyOutsideDict();
+        }
+        if (has_key_) {
+            ThrowKeyAfterKey();
+        }
+        writer_.Key(key);
+        has_key_ = true;
+        return *this;
     }
 
-    DictItemContext BaseContext::StartDict() {
-        return builder_.StartDict();
+    StreamBuilder &StreamBuilder::Value(Node::Value value) {
+        ThrowIfReadyObject("Value()");
+        CheckValueContext("Value()");
+
+        std::visit([this](auto simple_value) {
+            using Type = decltype(simple_value);
+            if constexpr (std::is_same_v<Type, std::nullptr_t>) {
+                writer_.Null();
+            } else if constexpr (std::is_same_v<Type, bool>) {
+                writer_.Bool(simple_value);
+            } else if constexpr (std::is_same_v<Type, int>) {
+                writer_.Int(simple_value);
+            } else if constexpr (std::is_same_v<Type, double>) {
+                writer_.Double(simple_value);
+            } else {
+                writer_.String(simple_value);
+            }
+        }, value);
+        AfterValue();
+        return *this;
     }
 
-    Builder &BaseContext::EndDict() {
-        return builder_.EndDict();
+    StreamBuilder &StreamBuilder::StringValue(const StringWriter &write) {
+        ThrowIfReadyObject("StringValue()");
+        CheckValueContext("StringValue()");
+
+        writer_.StartString();
+        {
+            StringStreamBuffer buffer(writer_);
+            std::ostream out(&buffer);
+            write(out);
+        } // деструктор буфера передаёт Writer последнюю часть строки
+        writer_.EndString();
+        AfterValue();
+        return *this;
     }
 
-    ArrayItemContext BaseContext::StartArray() {
-        return builder_.StartArray();
+    StreamBuilder &StreamBuilder::RawValue(std::string_view json) {
+        ThrowIfReadyObject("RawValue()");
+        CheckValueContext("RawValue()");
+
+        writer_.RawValue(json);
+        AfterValue();
+        return *this;
     }
 
-    Builder &BaseContext::EndArray() {
-        return builder_.EndArray();
+    StreamDictItemContext StreamBuilder::StartDict() {
+        ThrowIfReadyObject("StartDict()");
+        CheckValueContext("StartDict()");
+
+        writer_.StartDict();
+        containers_.push_back(true);
+        has_key_ = false;
+        return *this;
+    }
+
+    StreamBuilder &StreamBuilder::EndDict() {
+        ThrowIfReadyObject("EndDict()");
+        if (containers_.empty() || !containers_.back()) {
+            ThrowEndDictForWrongContainer();
+        }
+        if (has_key_) {
+            // ключ без значения, как и в Builder, получает значение null
+            writer_.Null();
+        }
+        writer_.EndDict();
+        containers_.pop_back();
+        AfterValue();
+        return *this;
     }
 
-    Node &BaseContext::Build() {
-        return builder_.Build();
+    StreamArrayItemContext StreamBuilder::StartArray() {
+        ThrowIfReadyObject("StartArray()");
+        CheckValueContext("StartArray()");
+
+        writer_.StartArray();
+        containers_.push_back(false);
+        has_key_ = false;
+        return *this;
+    }
+
+    StreamBuilder &StreamBuilder::EndArray() {
+        ThrowIfReadyObject("EndArray()");
+        if (containers_.empty() || containers_.back()) {
+            ThrowEndArrayForWrongContainer();
+        }
+        writer_.EndArray();
+        containers_.pop_back();
+        AfterValue();
+        return *this;
     }
 
 } // namespace json
\ No newline at end of file
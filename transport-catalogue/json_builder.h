@@ -8,20 +8,24 @@
  * или начинать его определение с помощью StartDict или StartArray.
  * - Value(Node::Value). Задаёт значение, соответствующее ключу при определении словаря, очередной элемент массива или,
  * если вызвать сразу после конструктора json::Builder, всё содержимое конструируемого JSON-объекта.
- * Может принимать как простой объект — число или строку — так и целый массив или словарь.
- * Здесь Node::Value — это синоним для базового класса Node, шаблона variant с набором возможных типов-значений.
+ * Принимает простое значение: null, bool, int, double или строку (Node::Value - variant этих типов, строка передаётся
+ * как std::string_view и сразу копируется в арену). Массивы и словари задаются через StartArray/StartDict.
+ * - StringValue(write). То же, что Value со строкой, но текст строки выводит в переданный поток функция write.
+ * Нужен для больших текстов, которые умеют выводить себя только в std::ostream (например, svg::Document).
+ * - RawValue(json). Только у StreamBuilder: выводит как значение готовый текст JSON (например, закэшированный ответ).
  * - StartDict(). Начинает определение сложного значения-словаря. Вызывается в тех же контекстах, что и Value.
  * Следующим вызовом обязательно должен быть Key или EndDict.
  * - StartArray(). Начинает определение сложного значения-массива. Вызывается в тех же контекстах, что и Value.
  * Следующим вызовом обязательно должен быть EndArray или любой, задающий новое значение: Value, StartDict или StartArray.
  * - EndDict(). Завершает определение сложного значения-словаря. Последним незавершённым вызовом Start* должен быть StartDict.
  * - EndArray(). Завершает определение сложного значения-массива. Последним незавершённым вызовом Start* должен быть StartArray.
- * - Build(). Возвращает объект json::Node, содержащий JSON, описанный предыдущими вызовами методов.
+ * - Build(). Возвращает json::Document, содержащий JSON, описанный предыдущими вызовами методов. Документу передаётся
+ * арена, в которой Builder размещал строки, массивы и словари, поэтому Build можно вызвать только один раз.
  * К этому моменту для каждого Start* должен быть вызван соответствующий End*. При этом сам объект должен быть определён,
  * то есть вызов json::Builder{}.Build() недопустим.
  *
  * Описанный синтаксис позволяет указывать ключи словаря в определённом порядке. Тем не менее, в данном случае это учитывать не нужно.
- * Словари всё так же должны храниться с помощью контейнера map.
+ * Словари хранятся отсортированными по ключу (json::Dict), при повторе ключа остаётся первое значение.
  *
  * В случае использования методов в неверном контексте ваш код должен выбросить исключение типа std::logic_error с понятным сообщением об ошибке.
  * Это должно происходить в следующих ситуациях:
@@ -51,16 +55,36 @@
 
 #include "json.h"
 
+#include <functional>
+#include <memory>
 #include <optional>
+#include <ostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace json {
 
-    struct DictItemContext;
-    struct ArrayItemContext;
-    struct KeyContext;
-    struct DictValueContext;
+    /* Контексты цепочек вызовов общие для Builder и StreamBuilder: Owner - класс, методы которого они вызывают */
+    template <typename Owner>
+    struct BasicDictItemContext;
+    template <typename Owner>
+    struct BasicArrayItemContext;
+    template <typename Owner>
+    struct BasicKeyContext;
+    template <typename Owner>
+    struct BasicDictValueContext;
+
+    class Builder;
+    class StreamBuilder;
+
+    /* Функция, которая выводит текст значения-строки в поток (см. StringValue) */
+    using StringWriter = std::function<void(std::ostream &)>;
+
+    using DictItemContext = BasicDictItemContext<Builder>;
+    using ArrayItemContext = BasicArrayItemContext<Builder>;
+    using KeyContext = BasicKeyContext<Builder>;
+    using DictValueContext = BasicDictValueContext<Builder>;
 
     class Builder {
     public:
@@ -72,87 +96,192 @@ namespace json {
         Builder& operator=(const Builder&) = delete;
         Builder& operator=(Builder&&) = default;
 
-        KeyContext Key(const std::string &);
-        Builder &Value(Node::Value &&value);
+        KeyContext Key(std::string_view key);
+        Builder &Value(Node::Value value);
+        Builder &StringValue(const StringWriter &write);
         DictItemContext StartDict();
         Builder &EndDict();
         ArrayItemContext StartArray();
         Builder &EndArray();
-        Node &Build();
+        Document Build();
 
     private:
+        /* Незаконченный массив или словарь: его элементы лежат в values_ (items_) начиная с first */
+        struct Container {
+            bool is_dict;
+            size_t first;
+            std::optional<std::string_view> key; // ключ, под которым контейнер войдёт в родительский словарь
+        };
+
         void ThrowIfReadyObject(std::string func_name);
+        /* Проверяет, что значение можно добавить в текущий контекст (см. п. 4 ограничений выше) */
+        void CheckValueContext(const std::string &func_name) const;
+        void AddValue(Node value);
 
-        Node root_;
-        std::vector<Node *> nodes_stack_; /*стек указателей на те вершины JSON, которые ещё не построены*/
-        std::optional<std::string> last_key_;
+        std::unique_ptr<Arena> arena_;
+        std::vector<Container> containers_; /*стек ещё не построенных массивов и словарей*/
+        std::vector<Node> values_;
+        std::vector<DictItem> items_;
+        std::optional<std::string_view> last_key_;
+        std::optional<Node> root_;
     };
 
-    struct BaseContext {
-        BaseContext(Builder &builder) : builder_(builder) {}
+    using StreamDictItemContext = BasicDictItemContext<StreamBuilder>;
+    using StreamArrayItemContext = BasicArrayItemContext<StreamBuilder>;
+    using StreamKeyContext = BasicKeyContext<StreamBuilder>;
+    using StreamDictValueContext = BasicDictValueContext<StreamBuilder>;
 
-        KeyContext Key(std::string key);
-        Builder &Value(Node::Value value);
-        DictItemContext StartDict();
-        Builder& EndDict();
-        ArrayItemContext StartArray();
-        Builder& EndArray();
-        Node& Build();
+    /*
+     * Потоковый вариант Builder: те же цепочки вызовов и те же ошибки порядка вызовов (при компиляции и std::logic_error),
+     * но значения сразу отдаются json::Writer, а не собираются в Document, поэтому память не растёт с размером JSON.
+     * Отличия от Builder:
+     * 1) ключи словаря выводятся в порядке вызовов Key, повторяющиеся ключи не удаляются;
+     * 2) Build нет: значение выведено, когда закрыт последний контейнер (IsReady).
+     */
+    class StreamBuilder {
+    public:
+        explicit StreamBuilder(Writer &writer)
+            : writer_(writer) {
+        }
+        StreamBuilder(const StreamBuilder &) = delete;
+        StreamBuilder &operator=(const StreamBuilder &) = delete;
+
+        StreamKeyContext Key(std::string_view key);
+        StreamBuilder &Value(Node::Value value);
+        /* Текст экранируется и уходит в Writer по мере вывода, целиком строка в памяти не собирается */
+        StreamBuilder &StringValue(const StringWriter &write);
+        StreamBuilder &RawValue(std::string_view json);
+        StreamDictItemContext StartDict();
+        StreamBuilder &EndDict();
+        StreamArrayItemContext StartArray();
+        StreamBuilder &EndArray();
+
+        bool IsReady() const {
+            return ready_;
+        }
+
+    private:
+        void ThrowIfReadyObject(const std::string &func_name) const;
+        void CheckValueContext(const std::string &func_name) const;
+        /* Значение выведено: если это корень, объект готов */
+        void AfterValue();
+
+        Writer &writer_;
+        std::vector<bool> containers_; // стек открытых контейнеров: true - словарь, false - массив
+        bool has_key_ = false;         // в словаре выведен ключ без значения
+        bool ready_ = false;
+    };
+
+    template <typename Owner>
+    struct BasicBaseContext {
+        BasicBaseContext(Owner &builder) : builder_(builder) {}
+
+        BasicKeyContext<Owner> Key(std::string_view key) {
+            return builder_.Key(key);
+        }
+        Owner &Value(Node::Value value) {
+            return builder_.Value(std::move(value));
+        }
+        Owner &StringValue(const StringWriter &write) {
+            return builder_.StringValue(write);
+        }
+        Owner &RawValue(std::string_view json) {
+            return builder_.RawValue(json);
+        }
+        BasicDictItemContext<Owner> StartDict() {
+            return builder_.StartDict();
+        }
+        Owner &EndDict() {
+            return builder_.EndDict();
+        }
+        BasicArrayItemContext<Owner> StartArray() {
+            return builder_.StartArray();
+        }
+        Owner &EndArray() {
+            return builder_.EndArray();
+        }
+        auto Build() {
+            return builder_.Build();
+        }
 
-        Builder &builder_;
+        Owner &builder_;
     };
 
     /*За вызовом StartDict следует не Key и не EndDict.*/
-    struct DictItemContext : BaseContext {
+    template <typename Owner>
+    struct BasicDictItemContext : BasicBaseContext<Owner> {
 
-        DictItemContext(Builder &builder) : BaseContext(builder) {}
+        BasicDictItemContext(Owner &builder) : BasicBaseContext<Owner>(builder) {}
 
-        // KeyContext Key(std::string key) = delete;
-        Builder &Value(Node::Value value) = delete;
-        DictItemContext StartDict() = delete;
+        // KeyContext Key(std::string_view key) = delete;
+        Owner &Value(Node::Value value) = delete;
+        Owner &StringValue(const StringWriter &write) = delete;
+        Owner &RawValue(std::string_view json) = delete;
+        BasicDictItemContext StartDict() = delete;
         // Builder& EndDict() = delete;
-        ArrayItemContext StartArray() = delete;
-        Builder& EndArray() = delete;
-        Node& Build() = delete;
+        BasicArrayItemContext<Owner> StartArray() = delete;
+        Owner& EndArray() = delete;
+        void Build() = delete;
     };
 
     /*За вызовом StartArray следует не Value, не StartDict, не StartArray и не EndArray.*/
     /*После вызова StartArray и серии Value следует не Value, не StartDict, не StartArray и не EndArray.*/
-    struct ArrayItemContext : BaseContext {
-        ArrayItemContext(Builder &builder) : BaseContext(builder) {}
+    template <typename Owner>
+    struct BasicArrayItemContext : BasicBaseContext<Owner> {
+        BasicArrayItemContext(Owner &builder) : BasicBaseContext<Owner>(builder) {}
 
-        KeyContext Key(std::string key) = delete;
-        ArrayItemContext Value(Node::Value value);
+        BasicKeyContext<Owner> Key(std::string_view key) = delete;
+        BasicArrayItemContext Value(Node::Value value) {
+            return this->builder_.Value(std::move(value));
+        }
+        BasicArrayItemContext StringValue(const StringWriter &write) {
+            return this->builder_.StringValue(write);
+        }
+        BasicArrayItemContext RawValue(std::string_view json) {
+            return this->builder_.RawValue(json);
+        }
         // DictItemContext StartDict() = delete;
-        Builder& EndDict() = delete;
+        Owner& EndDict() = delete;
         // ArrayItemContext StartArray() = delete;
         // Builder &EndArray() = delete;
-        Node &Build() = delete;
+        void Build() = delete;
     };
 
     /*Непосредственно после Key вызван не Value, не StartDict и не StartArray.*/
-    struct KeyContext : BaseContext {
-        KeyContext(Builder &builder) : BaseContext(builder) {}
+    template <typename Owner>
+    struct BasicKeyContext : BasicBaseContext<Owner> {
+        BasicKeyContext(Owner &builder) : BasicBaseContext<Owner>(builder) {}
 
-        KeyContext Key(std::string key) = delete;
-        DictValueContext Value(Node::Value value);
+        BasicKeyContext Key(std::string_view key) = delete;
+        BasicDictValueContext<Owner> Value(Node::Value value) {
+            return this->builder_.Value(std::move(value));
+        }
+        BasicDictValueContext<Owner> StringValue(const StringWriter &write) {
+            return this->builder_.StringValue(write);
+        }
+        BasicDictValueContext<Owner> RawValue(std::string_view json) {
+            return this->builder_.RawValue(json);
+        }
         // DictItemContext StartDict() = delete;
-        Builder& EndDict() = delete;
+        Owner& EndDict() = delete;
         // ArrayItemContext StartArray() = delete;
-        Builder &EndArray() = delete;
-        Node &Build() = delete;
+        Owner &EndArray() = delete;
+        void Build() = delete;
     };
 
     /*После вызова Value, последовавшего за вызовом Key, вызван не Key и не EndDict.*/
-    struct DictValueContext : BaseContext {
-        DictValueContext(Builder &builder) : BaseContext(builder) {}
+    template <typename Owner>
+    struct BasicDictValueContext : BasicBaseContext<Owner> {
+        BasicDictValueContext(Owner &builder) : BasicBaseContext<Owner>(builder) {}
 
-        // KeyContext Key(std::string key) = delete;
-        Builder &Value(Node::Value value) = delete; // !!!!!!!!!!!!!!!!!! BaseContext&   ???????????????
-        DictItemContext StartDict() = delete;
+        // KeyContext Key(std::string_view key) = delete;
+        Owner &Value(Node::Value value) = delete; // !!!!!!!!!!!!!!!!!! BaseContext&   ???????????????
+        Owner &StringValue(const StringWriter &write) = delete;
+        Owner &RawValue(std::string_view json) = delete;
+        BasicDictItemContext<Owner> StartDict() = delete;
         // Builder& EndDict() = delete;
-        ArrayItemContext StartArray() = delete;
-        Builder &EndArray() = delete;
-        Node &Build() = delete;
+        BasicArrayItemContext<Owner> StartArray() = delete;
+        Owner &EndArray() = delete;
+        void Build() = delete;
     };
 } // namespace json
\ No newline at end of file
@@ -3,7 +3,15 @@
  */
 #include "json_reader.h"
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+
 using namespace json;
+using namespace std::literals;
 
 namespace transport {
 
@@ -11,88 +19,413 @@ namespace transport {
 
     namespace json_reader {
 
-        void JsonReader::FillTransportCatalogue(Document &document, TransportCatalogue &catalogue) {
-            const Node &root_node = document.GetRoot();
-
-/* --------------------- Обрабатываем запросы на пополнение базы ---------------------- */
-                ReadBaseRequests(root_node, catalogue);
-                FillStopDistances(catalogue);
-                FillBusses(catalogue);
+        const KeyTable &JsonReader::GetKeyTable() const {
+            static const KeyTable keys{str_request_type_fill_, str_request_type_stat_, str_render_settings_, str_router_settings,
+                                       str_type_, str_name_, str_id_, str_stop_lat_, str_stop_long_, str_stop_road_dist_,
+                                       str_bus_stops_, str_bus_roundtrip_, str_from_, str_to_, str_count_, str_min_lat_,
+                                       str_min_long_, str_max_lat_, str_max_long_, str_prefix_, str_from_position_, str_to_position_};
+            return keys;
         }
+
         /*
-         * - вносит в каталог записи "Stop" без расстояний;
-         * - указатели на ноды с массивами расстояний до остановок складывает в вектор stop_distances_;
-         * - указатели на ноды с записями маршрутов складывает в вектор buses_
+         * Разбор base_requests событиями. Состояния обработчика:
+         * - ROOT - ждём словарь верхнего уровня, TOP_LEVEL - ждём ключ верхнего уровня;
+         * - TOP_LEVEL_VALUE - значение ключа, отличного от base_requests, собирается в дерево (node_handler_);
+         * - BASE_REQUESTS_START - ждём начало массива base_requests, BASE_REQUESTS - ждём очередную запись массива;
+         * - REQUEST - ждём ключ записи "Stop" или "Bus", REQUEST_VALUE - значение поля записи собирается в дерево;
+         * - ROAD_DISTANCES_START, ROAD_DISTANCES - словарь road_distances, расстояния сразу складываются в distances_;
+         * - BUS_STOPS_START, BUS_STOPS - массив stops, имена остановок сразу складываются в stops_.
+         * Тип записи может идти после остальных полей, поэтому запись обрабатывается по окончании её словаря (FinishRequest).
+         * Значения неверного типа вызывают те же исключения std::logic_error, что и методы Node::As...
+         * Значения верхнего уровня собираются в арене будущего документа (value_handler_), поля записи - в небольшой
+         * арене fields_arena_, которая освобождается после каждой записи и обычно не выходит за буфер fields_buffer_.
          */
-        void JsonReader::ReadBaseRequests(const Node &node, TransportCatalogue &catalogue) {
-            const Array &base_fill_array = node.AsMap().at(str_request_type_fill_).AsArray();
-            for (const Node &fill_node : base_fill_array) {
-                if (fill_node.AsMap().at(str_type_).AsString() == str_stop_type_) { // обработка записей с остановками
-                    catalogue.AddStop(fill_node.AsMap().at(str_name_).AsString(),
-                                      {fill_node.AsMap().at(str_stop_lat_).AsDouble(), fill_node.AsMap().at(str_stop_long_).AsDouble()});
-                    if (fill_node.AsMap().count(str_stop_road_dist_)) {
-                        stop_distances_.emplace_back(std::make_pair(fill_node.AsMap().at(str_name_).AsString(),
-                                                                    std::addressof(fill_node.AsMap().at(str_stop_road_dist_))));
+        class JsonReader::BaseRequestsHandler final : public json::Handler {
+        public:
+            BaseRequestsHandler(JsonReader &reader, CatalogueBuilder &catalogue)
+                : reader_(reader), catalogue_(catalogue) {
+            }
+
+            /* Документ из ключей верхнего уровня, кроме base_requests */
+            json::Document ExtractDocument() {
+                if (!has_base_requests_) {
+                    throw std::out_of_range("Key "s + reader_.str_request_type_fill_ + " not found"s);
+                }
+                const json::Node root(*arena_, top_level_.data(), top_level_.size());
+                return json::Document(root, std::move(arena_));
+            }
+
+            void Null() override {
+                Forward([](json::Handler &handler) { handler.Null(); });
+            }
+            void Bool(bool value) override {
+                Forward([value](json::Handler &handler) { handler.Bool(value); });
+            }
+            void Int(int value) override {
+                if (state_ == State::ROAD_DISTANCES) {
+                    distances_.emplace_back(std::move(distance_stop_), static_cast<size_t>(value));
+                    return;
+                }
+                Forward([value](json::Handler &handler) { handler.Int(value); });
+            }
+            void Double(double value) override {
+                Forward([value](json::Handler &handler) { handler.Double(value); });
+            }
+            void String(std::string_view value) override {
+                if (state_ == State::BUS_STOPS) {
+                    stops_.emplace_back(value);
+                    return;
+                }
+                Forward([value](json::Handler &handler) { handler.String(value); });
+            }
+
+            void Key(std::string_view key) override {
+                if (state_ == State::TOP_LEVEL) {
+                    if (key == reader_.str_request_type_fill_) {
+                        has_base_requests_ = true;
+                        state_ = State::BASE_REQUESTS_START;
+                    } else {
+                        value_key_ = InternKey(key, *arena_);
+                        state_ = State::TOP_LEVEL_VALUE;
+                    }
+                } else if (state_ == State::REQUEST) {
+                    if (key == reader_.str_bus_stops_) {
+                        has_stops_ = true;
+                        state_ = State::BUS_STOPS_START;
+                    } else if (key == reader_.str_stop_road_dist_) {
+                        state_ = State::ROAD_DISTANCES_START;
+                    } else {
+                        value_key_ = InternKey(key, fields_arena_);
+                        state_ = State::REQUEST_VALUE;
                     }
-                } else if (fill_node.AsMap().at(str_type_).AsString() == str_bus_type_) { // сохранение ссылок на записи с маршрутами
-                    buses_.emplace_back(std::addressof(fill_node));
+                } else if (state_ == State::ROAD_DISTANCES) {
+                    distance_stop_ = key;
+                } else {
+                    Forward([key](json::Handler &handler) { handler.Key(key); });
                 }
             }
-        }
 
-        void JsonReader::FillStopDistances(TransportCatalogue& catalogue) {
-            for(const auto& [stop_from, road_dist_node] : stop_distances_) {
-                for(const auto& [stop_to, node_dist] : road_dist_node->AsMap()) {
-                    catalogue.AddStopDistances(stop_from, stop_to, static_cast<size_t>(node_dist.AsInt()));
+            void StartArray() override {
+                if (state_ == State::BASE_REQUESTS_START) {
+                    state_ = State::BASE_REQUESTS;
+                } else if (state_ == State::BUS_STOPS_START) {
+                    state_ = State::BUS_STOPS;
+                } else {
+                    Forward([](json::Handler &handler) { handler.StartArray(); });
                 }
             }
-        }
+            void EndArray() override {
+                if (state_ == State::BASE_REQUESTS) {
+                    state_ = State::TOP_LEVEL;
+                } else if (state_ == State::BUS_STOPS) {
+                    state_ = State::REQUEST;
+                } else {
+                    Forward([](json::Handler &handler) { handler.EndArray(); });
+                }
+            }
+
+            void StartDict() override {
+                if (state_ == State::ROOT) {
+                    state_ = State::TOP_LEVEL;
+                } else if (state_ == State::BASE_REQUESTS) {
+                    state_ = State::REQUEST;
+                } else if (state_ == State::ROAD_DISTANCES_START) {
+                    state_ = State::ROAD_DISTANCES;
+                } else {
+                    Forward([](json::Handler &handler) { handler.StartDict(); });
+                }
+            }
+            void EndDict() override {
+                if (state_ == State::TOP_LEVEL) {
+                    state_ = State::DONE;
+                } else if (state_ == State::REQUEST) {
+                    FinishRequest();
+                    state_ = State::BASE_REQUESTS;
+                } else if (state_ == State::ROAD_DISTANCES) {
+                    state_ = State::REQUEST;
+                } else {
+                    Forward([](json::Handler &handler) { handler.EndDict(); });
+                }
+            }
+
+        private:
+            enum class State {
+                ROOT,
+                TOP_LEVEL,
+                TOP_LEVEL_VALUE,
+                BASE_REQUESTS_START,
+                BASE_REQUESTS,
+                REQUEST,
+                REQUEST_VALUE,
+                ROAD_DISTANCES_START,
+                ROAD_DISTANCES,
+                BUS_STOPS_START,
+                BUS_STOPS,
+                DONE
+            };
+
+            /* Событие внутри значения, собираемого в дерево. В остальных состояниях событие означает значение неверного типа */
+            template <typename Event>
+            void Forward(Event event) {
+                switch (state_) {
+                case State::TOP_LEVEL_VALUE:
+                    event(value_handler_);
+                    if (value_handler_.IsComplete()) {
+                        top_level_.emplace_back(value_key_, value_handler_.Extract());
+                        state_ = State::TOP_LEVEL;
+                    }
+                    return;
+                case State::REQUEST_VALUE:
+                    event(field_handler_);
+                    if (field_handler_.IsComplete()) {
+                        fields_.emplace_back(value_key_, field_handler_.Extract());
+                        state_ = State::REQUEST;
+                    }
+                    return;
+                case State::BASE_REQUESTS_START:
+                case State::BUS_STOPS_START:
+                    throw std::logic_error("Not Array");
+                case State::ROAD_DISTANCES:
+                    throw std::logic_error("Not integer");
+                case State::BUS_STOPS:
+                    throw std::logic_error("Not string");
+                default:
+                    throw std::logic_error("Not Map");
+                }
+            }
+
+            /* Ключ из таблицы ключей или его копия в арене */
+            std::string_view InternKey(std::string_view key, json::Arena &arena) const {
+                const std::optional<std::string_view> interned = reader_.GetKeyTable().Find(key);
+                return interned ? *interned : arena.CopyString(key);
+            }
+
+            /* Остановка вносится в каталог сразу, её расстояния и маршруты откладываются до конца разбора */
+            void FinishRequest() {
+                const Dict request = json::Node(fields_arena_, fields_.data(), fields_.size()).AsMap();
+                const std::string_view type = request.at(reader_.key_type_).AsString();
+                if (type == reader_.str_stop_type_) {
+                    const std::string_view name = request.at(reader_.key_name_).AsString();
+                    catalogue_.AddStop(name, {request.at(reader_.key_stop_lat_).AsDouble(), request.at(reader_.key_stop_long_).AsDouble()});
+                    for (auto &[stop_to, distance] : distances_) {
+                        reader_.deferred_distances_.push_back({std::string(name), std::move(stop_to), distance});
+                    }
+                } else if (type == reader_.str_bus_type_) {
+                    if (!has_stops_) {
+                        throw std::out_of_range("Key "s + reader_.str_bus_stops_ + " not found"s);
+                    }
+                    reader_.deferred_buses_.push_back({std::string(request.at(reader_.key_name_).AsString()), std::move(stops_),
+                                                       request.at(reader_.key_bus_roundtrip_).AsBool()});
+                }
+                fields_.clear();
+                fields_arena_.Release();
+                distances_.clear();
+                stops_.clear();
+                has_stops_ = false;
+            }
 
-        void JsonReader::FillBusses(TransportCatalogue &catalogue) {
-            for(size_t i = 0; i != buses_.size(); ++i) {
-                bool is_roundtrip = true;
-                std::vector<std::string_view> stop_names;
-                for (const Node &node_stop : buses_[i]->AsMap().at(str_bus_stops_).AsArray()) {
-                    stop_names.emplace_back(node_stop.AsString());
+            JsonReader &reader_;
+            CatalogueBuilder &catalogue_;
+            State state_ = State::ROOT;
+            std::unique_ptr<json::Arena> arena_ = std::make_unique<json::Arena>(); // арена возвращаемого документа
+            json::NodeHandler value_handler_{*arena_, &reader_.GetKeyTable()};
+            std::string_view value_key_;              // ключ значения, собираемого в value_handler_ или field_handler_
+            std::vector<json::DictItem> top_level_;   // ключи верхнего уровня, кроме base_requests
+            bool has_base_requests_ = false;
+
+            // поля текущей записи base_requests
+            std::array<std::byte, 4096> fields_buffer_;
+            json::Arena fields_arena_{fields_buffer_.data(), fields_buffer_.size()};
+            json::NodeHandler field_handler_{fields_arena_, &reader_.GetKeyTable()};
+            std::vector<json::DictItem> fields_;
+            std::vector<std::pair<std::string, size_t>> distances_;
+            std::string distance_stop_;
+            std::vector<std::string> stops_;
+            bool has_stops_ = false;
+        };
+
+        /*
+         * Разбор документа без base_requests, когда справочник загружается из снимка. Состояния обработчика:
+         * - ROOT - ждём словарь верхнего уровня, TOP_LEVEL - ждём ключ верхнего уровня;
+         * - TOP_LEVEL_VALUE - значение ключа, отличного от base_requests, собирается в дерево (value_handler_);
+         * - SKIPPED_VALUE - значение base_requests: события только отсчитывают глубину вложенности, узлы не создаются.
+         */
+        class JsonReader::SkipBaseRequestsHandler final : public json::Handler {
+        public:
+            explicit SkipBaseRequestsHandler(const JsonReader &reader)
+                : reader_(reader) {
+            }
+
+            /* Документ из ключей верхнего уровня, кроме base_requests */
+            json::Document ExtractDocument() {
+                const json::Node root(*arena_, top_level_.data(), top_level_.size());
+                return json::Document(root, std::move(arena_));
+            }
+
+            void Null() override {
+                Forward(0, [](json::Handler &handler) { handler.Null(); });
+            }
+            void Bool(bool value) override {
+                Forward(0, [value](json::Handler &handler) { handler.Bool(value); });
+            }
+            void Int(int value) override {
+                Forward(0, [value](json::Handler &handler) { handler.Int(value); });
+            }
+            void Double(double value) override {
+                Forward(0, [value](json::Handler &handler) { handler.Double(value); });
+            }
+            void String(std::string_view value) override {
+                Forward(0, [value](json::Handler &handler) { handler.String(value); });
+            }
+
+            void Key(std::string_view key) override {
+                if (state_ == State::TOP_LEVEL) {
+                    if (key == reader_.str_request_type_fill_) {
+                        state_ = State::SKIPPED_VALUE;
+                    } else {
+                        const std::optional<std::string_view> interned = reader_.GetKeyTable().Find(key);
+                        value_key_ = interned ? *interned : arena_->CopyString(key);
+                        state_ = State::TOP_LEVEL_VALUE;
+                    }
+                } else {
+                    Forward(0, [key](json::Handler &handler) { handler.Key(key); });
+                }
+            }
+
+            void StartArray() override {
+                Forward(1, [](json::Handler &handler) { handler.StartArray(); });
+            }
+            void EndArray() override {
+                Forward(-1, [](json::Handler &handler) { handler.EndArray(); });
+            }
+
+            void StartDict() override {
+                if (state_ == State::ROOT) {
+                    state_ = State::TOP_LEVEL;
+                } else {
+                    Forward(1, [](json::Handler &handler) { handler.StartDict(); });
                 }
-                if (!buses_[i]->AsMap().at(str_bus_roundtrip_).AsBool()) { // нужно замкнуть маршрут
-                    is_roundtrip = false;
-                    stop_names.insert(stop_names.end(), std::next(stop_names.rbegin()), stop_names.rend());
+            }
+            void EndDict() override {
+                if (state_ == State::TOP_LEVEL) {
+                    state_ = State::DONE;
+                } else {
+                    Forward(-1, [](json::Handler &handler) { handler.EndDict(); });
                 }
-                catalogue.AddBus(buses_[i]->AsMap().at(str_name_).AsString(), stop_names, is_roundtrip);
             }
+
+        private:
+            enum class State {
+                ROOT,
+                TOP_LEVEL,
+                TOP_LEVEL_VALUE,
+                SKIPPED_VALUE,
+                DONE
+            };
+
+            /* Событие внутри значения верхнего уровня, depth_change - изменение глубины вложенности (+1 начало, -1 конец контейнера) */
+            template <typename Event>
+            void Forward(int depth_change, Event event) {
+                switch (state_) {
+                case State::TOP_LEVEL_VALUE:
+                    event(value_handler_);
+                    if (value_handler_.IsComplete()) {
+                        top_level_.emplace_back(value_key_, value_handler_.Extract());
+                        state_ = State::TOP_LEVEL;
+                    }
+                    return;
+                case State::SKIPPED_VALUE:
+                    skipped_depth_ += depth_change;
+                    if (skipped_depth_ == 0) {
+                        state_ = State::TOP_LEVEL;
+                    }
+                    return;
+                default:
+                    throw std::logic_error("Not Map");
+                }
+            }
+
+            const JsonReader &reader_;
+            State state_ = State::ROOT;
+            std::unique_ptr<json::Arena> arena_ = std::make_unique<json::Arena>(); // арена возвращаемого документа
+            json::NodeHandler value_handler_{*arena_, &reader_.GetKeyTable()};
+            std::string_view value_key_;            // ключ значения, собираемого в value_handler_
+            std::vector<json::DictItem> top_level_; // ключи верхнего уровня, кроме base_requests
+            int skipped_depth_ = 0;                 // глубина вложенности внутри значения base_requests
+        };
+
+        json::Document JsonReader::FillTransportCatalogue(std::string_view text, CatalogueBuilder &catalogue) {
+            BaseRequestsHandler handler(*this, catalogue);
+            json::Parse(text, handler);
+
+            for (const DeferredDistance &distance : deferred_distances_) {
+                catalogue.AddStopDistances(distance.stop_from, distance.stop_to, distance.distance);
+            }
+            for (const DeferredBus &bus : deferred_buses_) {
+                const std::vector<std::string_view> stop_names(bus.stops.begin(), bus.stops.end());
+                catalogue.AddBus(bus.name, stop_names, bus.is_roundtrip);
+            }
+            deferred_distances_.clear();
+            deferred_buses_.clear();
+            return handler.ExtractDocument();
+        }
+
+        json::Document JsonReader::LoadWithoutBaseRequests(std::string_view text) const {
+            SkipBaseRequestsHandler handler(*this);
+            json::Parse(text, handler);
+            return handler.ExtractDocument();
         }
 
         const std::vector<StatRequest>& JsonReader::FillStatRequests(const json::Document &document) {
             const Node &node = document.GetRoot();
-            const Array &requests_array = node.AsMap().at(str_request_type_stat_).AsArray();
+            const Array requests_array = node.AsMap().at(key_request_type_stat_).AsArray();
 
             for (const Node &req_node : requests_array) {
+                const Dict req_dict = req_node.AsMap();
                 std::string name_string;
                 std::string from_string;
                 std::string to_string;
-                if (req_node.AsMap().count(str_name_)) {
-                    name_string = req_node.AsMap().at(str_name_).AsString();
+                if (req_dict.count(key_name_)) {
+                    name_string = req_dict.at(key_name_).AsString();
                 }
-                if (req_node.AsMap().count(str_from_)) {
-                    from_string = req_node.AsMap().at(str_from_).AsString();
+                if (req_dict.count(key_from_)) {
+                    from_string = req_dict.at(key_from_).AsString();
                 }
-                if (req_node.AsMap().count(str_to_)) {
-                    to_string = req_node.AsMap().at(str_to_).AsString();
+                if (req_dict.count(key_to_)) {
+                    to_string = req_dict.at(key_to_).AsString();
                 }
 
-                requests_.emplace_back(StatRequest{req_node.AsMap().at(str_id_).AsInt(),
-                                                    req_node.AsMap().at(str_type_).AsString(),
-                                                    name_string,
-                                                    from_string,
-                                                    to_string});
+                StatRequest &request = requests_.emplace_back(StatRequest{req_dict.at(key_id_).AsInt(),
+                                                                         std::string(req_dict.at(key_type_).AsString()),
+                                                                         name_string,
+                                                                         from_string,
+                                                                         to_string});
+                if (req_dict.count(key_stop_lat_) && req_dict.count(key_stop_long_)) {
+                    request.point = {req_dict.at(key_stop_lat_).AsDouble(), req_dict.at(key_stop_long_).AsDouble()};
+                }
+                if (req_dict.count(key_count_)) {
+                    request.count = static_cast<size_t>(std::max(req_dict.at(key_count_).AsInt(), 0));
                 }
+                if (req_dict.count(key_min_lat_) && req_dict.count(key_min_long_)) {
+                    request.box_min = {req_dict.at(key_min_lat_).AsDouble(), req_dict.at(key_min_long_).AsDouble()};
+                }
+                if (req_dict.count(key_max_lat_) && req_dict.count(key_max_long_)) {
+                    request.box_max = {req_dict.at(key_max_lat_).AsDouble(), req_dict.at(key_max_long_).AsDouble()};
+                }
+                if (req_dict.count(key_prefix_)) {
+                    request.prefix = req_dict.at(key_prefix_).AsString();
+                }
+                if (req_dict.count(key_from_position_) && req_dict.count(key_to_position_)) {
+                    request.from_position = static_cast<size_t>(std::max(req_dict.at(key_from_position_).AsInt(), 0));
+                    request.to_position = static_cast<size_t>(std::max(req_dict.at(key_to_position_).AsInt(), 0));
+                }
+            }
             return requests_;
         }
 
         svg::Color JsonReader::WhatColor(const Node& clr_node) {
             if (clr_node.IsString()) {
-                return clr_node.AsString();
+                return std::string(clr_node.AsString());
             } else if (clr_node.IsArray()) {
                 if (clr_node.AsArray().size() == 4) {
                     const svg::Rgba rgba_clr(static_cast<uint8_t>(clr_node.AsArray().at(0).AsInt()),
@@ -114,7 +447,7 @@ namespace transport {
             const Node &node = document.GetRoot();
             map_renderer::RenderSettings map_render_settings;
 
-            const Dict &settings_dict = node.AsMap().at(str_render_settings_).AsMap();
+            const Dict settings_dict = node.AsMap().at(str_render_settings_).AsMap();
             if (settings_dict.count(str_width_)) {
                 map_render_settings.width = settings_dict.at(str_width_).AsDouble();
             }
@@ -166,7 +499,7 @@ namespace transport {
             const Node &node = document.GetRoot();
             transport_router::RouterSetting router_settings;
 
-            const Dict &settings_dict = node.AsMap().at(str_router_settings).AsMap();
+            const Dict settings_dict = node.AsMap().at(str_router_settings).AsMap();
             if (settings_dict.count(str_bus_wait_time_)) {
                 router_settings.bus_wait_time = settings_dict.at(str_bus_wait_time_).AsInt();
             }
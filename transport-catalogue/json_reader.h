@@ -93,6 +93,7 @@
 
 #include <map>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -110,22 +111,40 @@ namespace transport {
             std::string name;
             std::string from;
             std::string to;
+            geo::Coordinates point{};   // для запроса NearestStops точка, от которой ищутся остановки
+            size_t count = 0;           // для запросов NearestStops и Autocomplete количество искомых остановок (маршрутов)
+            geo::Coordinates box_min{}; // для запроса StopsInBox минимальные широта и долгота
+            geo::Coordinates box_max{}; // для запроса StopsInBox максимальные широта и долгота
+            std::string prefix;         // для запроса Autocomplete начало имени остановки или маршрута
+            size_t from_position = 0;   // для запроса Segment позиции начала и конца участка в последовательности остановок маршрута
+            size_t to_position = 0;
         };
 
         class JsonReader {
         public:
             /*
-             * Наполняет данными транспортный справочник, из json::Document в три прохода:
-             * 1) пробегает весь JSON документ (ReadBaseRequests):
-             *          - вносит в каталог записи "Stop" без расстояний;
-             *          - ссылки на ноды с массивами расстояний до остановок складываем в вектор stop_distances_;
-             *          - ссылки на ноды с записями маршрутов в вектор buses_;
-             *          - ссылки на ноды с запросами в вектор requests_;
-             * 2) по вектору stop_distances_ вносит в каталог расстояния до остановок (FillStopDistances);
-             * 3) по вектору buses_ вносит в каталог информацию о маршрутах (FillBusses)
-             * Возвращает вектор с ссылками на ноды с запросами
+             * Наполняет справочник прямо из текста JSON, не строя дерево для base_requests (разбор событиями, json::Parse):
+             * 1) запись "Stop" вносится в каталог, как только закончится её словарь;
+             * 2) расстояния и маршруты могут ссылаться на остановки, описанные дальше по тексту, поэтому они копятся
+             * в векторах deferred_distances_ и deferred_buses_ и вносятся в каталог после разбора.
+             * Остальные ключи верхнего уровня собираются в дерево: возвращается json::Document без base_requests,
+             * из которого затем читаются настройки и запросы.
+             * Справочник завершается и публикуется вызывающим кодом (CatalogueBuilder::Build)
              */
-            void FillTransportCatalogue(json::Document &document, catalogue::TransportCatalogue &catalogue);
+            json::Document FillTransportCatalogue(std::string_view text, catalogue::CatalogueBuilder &catalogue);
+
+            /*
+             * Документ из текста JSON без base_requests - для справочника, загруженного из снимка.
+             * Массив base_requests, если он есть, только проверяется разбором: узлы для него не создаются
+             */
+            json::Document LoadWithoutBaseRequests(std::string_view text) const;
+
+            /*
+             * Таблица ключей записей base_requests и stat_requests и ключей верхнего уровня. Документ, загруженный с ней
+             * (json::Load(text, &GetKeyTable()), как и документ из FillTransportCatalogue), не копирует эти ключи,
+             * а поиск по ним при чтении запросов сравнивает адреса. Таблица общая для всех JsonReader и живёт до конца программы
+             */
+            const json::KeyTable &GetKeyTable() const;
 
             /* --------------------- настройки складываем в структуру map_render_settings_, она пойдёт в map_renderer.cpp ---------------------- */
             map_renderer::RenderSettings FillRenderSettings(const json::Document &document);
@@ -137,15 +156,27 @@ namespace transport {
             transport_router::RouterSetting FillRouterSettings(const json::Document &document);
 
         private:
-            /* --------------------- Обрабатываем запросы на пополнение базы ---------------------- */
-            void ReadBaseRequests(const json::Node &node, catalogue::TransportCatalogue &catalogue);
-            void FillStopDistances(catalogue::TransportCatalogue &catalogue);
-            void FillBusses(catalogue::TransportCatalogue &catalogue);
-
             svg::Color WhatColor(const json::Node& clr_node);
 
-            std::vector < std::pair<std::string, const json::Node*>> stop_distances_;
-            std::vector<const json::Node*> buses_;
+            /* Обработчик событий разбора для FillTransportCatalogue(std::string_view, ...) */
+            class BaseRequestsHandler;
+            /* Обработчик событий разбора для LoadWithoutBaseRequests */
+            class SkipBaseRequestsHandler;
+
+            struct DeferredDistance {
+                std::string stop_from;
+                std::string stop_to;
+                size_t distance = 0;
+            };
+
+            struct DeferredBus {
+                std::string name;
+                std::vector<std::string> stops;
+                bool is_roundtrip = false;
+            };
+
+            std::vector<DeferredDistance> deferred_distances_;
+            std::vector<DeferredBus> deferred_buses_;
             std::vector<StatRequest> requests_;
 
             const std::string str_request_type_fill_ = "base_requests";
@@ -184,6 +215,34 @@ namespace transport {
 
             const std::string str_from_ = "from";
             const std::string str_to_ = "to";
+
+            const std::string str_count_ = "count";
+            const std::string str_min_lat_ = "min_latitude";
+            const std::string str_min_long_ = "min_longitude";
+            const std::string str_max_lat_ = "max_latitude";
+            const std::string str_max_long_ = "max_longitude";
+            const std::string str_prefix_ = "prefix";
+            const std::string str_from_position_ = "from_position";
+            const std::string str_to_position_ = "to_position";
+
+            // дескрипторы ключей из GetKeyTable()
+            const json::InternedKey key_request_type_stat_ = GetKeyTable().Get(str_request_type_stat_);
+            const json::InternedKey key_type_ = GetKeyTable().Get(str_type_);
+            const json::InternedKey key_name_ = GetKeyTable().Get(str_name_);
+            const json::InternedKey key_id_ = GetKeyTable().Get(str_id_);
+            const json::InternedKey key_stop_lat_ = GetKeyTable().Get(str_stop_lat_);
+            const json::InternedKey key_stop_long_ = GetKeyTable().Get(str_stop_long_);
+            const json::InternedKey key_bus_roundtrip_ = GetKeyTable().Get(str_bus_roundtrip_);
+            const json::InternedKey key_from_ = GetKeyTable().Get(str_from_);
+            const json::InternedKey key_to_ = GetKeyTable().Get(str_to_);
+            const json::InternedKey key_count_ = GetKeyTable().Get(str_count_);
+            const json::InternedKey key_min_lat_ = GetKeyTable().Get(str_min_lat_);
+            const json::InternedKey key_min_long_ = GetKeyTable().Get(str_min_long_);
+            const json::InternedKey key_max_lat_ = GetKeyTable().Get(str_max_lat_);
+            const json::InternedKey key_max_long_ = GetKeyTable().Get(str_max_long_);
+            const json::InternedKey key_prefix_ = GetKeyTable().Get(str_prefix_);
+            const json::InternedKey key_from_position_ = GetKeyTable().Get(str_from_position_);
+            const json::InternedKey key_to_position_ = GetKeyTable().Get(str_to_position_);
         };
 
     } // namespace json_reader
@@ -1,31 +1,147 @@
+#include "catalogue_serialization.h"
+#include "catalogue_snapshot.h"
 #include "json.h"
 #include "json_reader.h"
 #include "map_renderer.h"
+#include "mapped_file.h"
 #include "request_handler.h"
+#include "server.h"
 #include "transport_router.h"
 
+#include <exception>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
 
 using namespace transport;
 
-int main() {
-    // Считать JSON из stdin
-    json::Document document = json::Load(std::cin);
+namespace {
+    /*
+     * Параметры командной строки:
+     * 1) без параметров - справочник строится по base_requests из JSON в stdin;
+     * 2) --snapshot <файл> - справочник загружается из двоичного снимка, из JSON в stdin берутся только настройки и stat_requests;
+     * 3) --make-snapshot <файл> - справочник строится по base_requests из JSON в stdin и сохраняется в двоичный снимок, запросы не выполняются.
+     * 4) --input <файл> - JSON читается не из stdin, а из файла, отображённого в память (можно сочетать с 2 и 3).
+     * 5) --serve <порт | путь сокета> - после загрузки справочника и настроек процесс становится сервером (см. server.h)
+     * и отвечает на пачки запросов клиентов, stat_requests из JSON не нужны (можно сочетать с 2 и 4).
+     * 6) --compact - ответы на stat_requests выводятся компактным JSON в одну строку, по умолчанию - с отступами.
+     */
+    struct ProgramOptions {
+        std::optional<std::string> snapshot_input;
+        std::optional<std::string> snapshot_output;
+        std::optional<std::string> json_input;
+        std::optional<std::string> serve_address;
+        bool compact_output = false;
+    };
 
-    // Построить на основе JSON базу данных транспортного справочника
-    catalogue::TransportCatalogue catalogue;
-    json_reader::JsonReader fill_catalogue;
-    fill_catalogue.FillTransportCatalogue(document, catalogue);
+    std::optional<ProgramOptions> ParseCommandLine(int argc, char *argv[]) {
+        using namespace std::literals;
 
-    // считать настройки построения карты
-    const map_renderer::RenderSettings draw_settings = fill_catalogue.FillRenderSettings(document);
+        ProgramOptions options;
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg = argv[i];
+            if (arg == "--compact"sv) {
+                options.compact_output = true;
+                continue;
+            }
+            if (i + 1 == argc) {
+                return std::nullopt;
+            }
+            if (arg == "--snapshot"sv) {
+                options.snapshot_input = argv[++i];
+            } else if (arg == "--make-snapshot"sv) {
+                options.snapshot_output = argv[++i];
+            } else if (arg == "--input"sv) {
+                options.json_input = argv[++i];
+            } else if (arg == "--serve"sv) {
+                options.serve_address = argv[++i];
+            } else {
+                return std::nullopt;
+            }
+        }
+        if ((options.snapshot_input || options.serve_address) && options.snapshot_output) {
+            return std::nullopt;
+        }
+        return options;
+    }
 
-    const transport_router::RouterSetting router_settings = fill_catalogue.FillRouterSettings(document);
+    void PrintUsage(std::ostream &stream) {
+        stream << "Usage: transport_catalogue [--snapshot <file> | --make-snapshot <file>] [--serve <port | socket path>]"
+                  " [--compact] [--input <file.json> | < input.json]\n";
+    }
+} // namespace
 
-    // Выполнить запросы к справочнику, находящиеся в массиве "stat_requests", построив JSON-массив
-    const std::vector<json_reader::StatRequest> &stat_requests = fill_catalogue.FillStatRequests(document);
+int main(int argc, char *argv[]) {
+    const std::optional<ProgramOptions> options = ParseCommandLine(argc, argv);
+    if (!options) {
+        PrintUsage(std::cerr);
+        return 1;
+    }
 
-    request_handler::RequestHandler req_hndlr(stat_requests, catalogue, draw_settings, router_settings);
+    // ошибки ввода-вывода, снимка и разбора JSON выводятся в stderr, программа завершается с кодом 1
+    try {
+        // Считать JSON из файла (через mmap) или из stdin
+        std::optional<MappedFile> input_file;
+        std::string input_text;
+        std::string_view input;
+        if (options->json_input) {
+            input = input_file.emplace(*options->json_input).GetData();
+        } else {
+            input_text = json::ReadStream(std::cin);
+            input = input_text;
+        }
 
-    json::Print(req_hndlr.GetStatistics(), std::cout);
-}
\ No newline at end of file
+        // Построить базу данных транспортного справочника (по JSON или из снимка) и опубликовать её снимок.
+        // base_requests вносятся в справочник прямо во время разбора JSON, остальные ключи собираются в json::Document.
+        // Со снимком справочника base_requests не нужны и в дерево не разбираются: снимок загружается в фоне, пока разбираются
+        // настройки и stat_requests
+        std::future<std::shared_ptr<const catalogue::TransportCatalogue>> snapshot_loading;
+        if (options->snapshot_input) {
+            snapshot_loading = std::async(std::launch::async, serialization::LoadCatalogue, *options->snapshot_input);
+        }
+        json_reader::JsonReader fill_catalogue;
+        catalogue::CatalogueBuilder catalogue_builder;
+        json::Document document = options->snapshot_input ? fill_catalogue.LoadWithoutBaseRequests(input) : fill_catalogue.FillTransportCatalogue(input, catalogue_builder);
+        catalogue::CatalogueSnapshotHolder catalogue;
+        catalogue.Publish(options->snapshot_input ? snapshot_loading.get() : catalogue_builder.Build());
+
+        if (options->snapshot_output) {
+            std::ofstream snapshot_file(*options->snapshot_output, std::ios::binary);
+            if (!snapshot_file) {
+                throw serialization::SnapshotError("Cannot open file " + *options->snapshot_output);
+            }
+            serialization::SaveCatalogue(*catalogue.Get(), snapshot_file);
+            // close сбрасывает буфер потока: ошибка последней записи (например, нет места на диске) видна только после него
+            snapshot_file.close();
+            if (!snapshot_file) {
+                throw serialization::SnapshotError("Failed to write catalogue snapshot " + *options->snapshot_output);
+            }
+            return 0;
+        }
+
+        // считать настройки построения карты
+        const map_renderer::RenderSettings draw_settings = fill_catalogue.FillRenderSettings(document);
+
+        const transport_router::RouterSetting router_settings = fill_catalogue.FillRouterSettings(document);
+
+        if (options->serve_address) {
+            server::Server(catalogue, draw_settings, router_settings).Run(*options->serve_address);
+        }
+
+        // Выполнить запросы к справочнику, находящиеся в массиве "stat_requests", построив JSON-массив
+        const std::vector<json_reader::StatRequest> &stat_requests = fill_catalogue.FillStatRequests(document);
+
+        request_handler::SharedResources resources;
+        request_handler::RequestHandler req_hndlr(stat_requests, catalogue, draw_settings, router_settings, resources);
+
+        json::Writer writer(std::cout, options->compact_output ? json::Writer::Format::COMPACT : json::Writer::Format::PRETTY);
+        req_hndlr.WriteStatistics(writer);
+    } catch (const std::exception &error) {
+        std::cerr << error.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,73 @@
+#include "map_cache.h"
+#include "json.h"
+#include "json_builder.h"
+
+#include <algorithm>
+#include <exception>
+#include <sstream>
+#include <utility>
+
+namespace transport {
+    namespace request_handler {
+
+        std::shared_ptr<const std::string> MapCache::GetMap(const catalogue::TransportCatalogue &catalogue,
+                                                            const map_renderer::RenderSettings &settings) {
+            const uint64_t version = catalogue.GetVersion();
+            const size_t settings_hash = map_renderer::RenderSettingsHasher{}(settings);
+            const auto is_key = [&](const Entry &entry) {
+                return entry.version == version && entry.settings_hash == settings_hash && entry.settings == settings;
+            };
+
+            std::promise<std::shared_ptr<const std::string>> promise;
+            std::shared_future<std::shared_ptr<const std::string>> cached_map;
+            {
+                // поиск и добавление под одной блокировкой: карту для ключа рисует ровно один поток
+                std::lock_guard lock(mutex_);
+                const auto found = std::find_if(entries_.begin(), entries_.end(), is_key);
+                if (found != entries_.end()) {
+                    cached_map = found->map;
+                } else {
+                    entries_.erase(std::remove_if(entries_.begin(), entries_.end(), [version](const Entry &entry) {
+                        return entry.version != version;
+                    }), entries_.end());
+                    if (entries_.size() == MAX_MAPS) {
+                        entries_.erase(entries_.begin());
+                    }
+                    entries_.push_back({version, settings_hash, settings, promise.get_future().share()});
+                }
+            }
+            if (cached_map.valid()) {
+                // карта уже нарисована или её дорисовывает другой поток
+                return cached_map.get();
+            }
+
+            try {
+                std::shared_ptr<const std::string> map = RenderMap(catalogue, settings);
+                promise.set_value(map);
+                return map;
+            } catch (...) {
+                // ожидающие потоки получат ту же ошибку, а следующий запрос попробует нарисовать карту заново
+                promise.set_exception(std::current_exception());
+                std::lock_guard lock(mutex_);
+                entries_.erase(std::remove_if(entries_.begin(), entries_.end(), is_key), entries_.end());
+                throw;
+            }
+        }
+
+        std::shared_ptr<const std::string> MapCache::RenderMap(const catalogue::TransportCatalogue &catalogue,
+                                                               const map_renderer::RenderSettings &settings) {
+            map_renderer::MapRenderer map_drawer(catalogue, settings);
+            const svg::Document &map_picture = map_drawer.DrawMap();
+
+            std::ostringstream out;
+            {
+                json::Writer writer(out, json::Writer::Format::COMPACT);
+                json::StreamBuilder(writer).StringValue([&map_picture](std::ostream &svg_out) {
+                    map_picture.Render(svg_out);
+                });
+            }
+            return std::make_shared<const std::string>(out.str());
+        }
+
+    } // namespace request_handler
+} // namespace transport
@@ -0,0 +1,52 @@
+#pragma once
+/*
+ * Кэш готовых карт для запросов Map.
+ * Карта зависит только от снимка справочника и настроек отрисовки, поэтому хранится по ключу (версия снимка, хеш RenderSettings)
+ * уже в виде ответа: SVG-документ, записанный как значение-строка JSON (в кавычках и с экранированием).
+ * Одинаковые запросы Map в пачке и в следующих пачках долгоживущего процесса отрисовываются один раз и выводятся копированием.
+ *
+ * 1) GetMap можно вызывать из нескольких потоков. Карту рисует первый запросивший её поток (вне блокировки),
+ * остальные ждут готовую карту, а не рисуют её повторно.
+ * 2) Хранятся карты только последнего запрошенного снимка справочника: с публикацией нового снимка старые карты не нужны.
+ * Для одного снимка хранится не больше MAX_MAPS карт с разными настройками, первой вытесняется самая старая.
+ * 3) При совпадении хешей настройки сравниваются целиком, так что коллизия хеша не выдаст чужую карту.
+ */
+#include "map_renderer.h"
+#include "transport_catalogue.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace transport {
+    namespace request_handler {
+
+        class MapCache {
+        public:
+            /* Готовое значение JSON для ключа "map" ответа на запрос Map */
+            std::shared_ptr<const std::string> GetMap(const catalogue::TransportCatalogue &catalogue,
+                                                      const map_renderer::RenderSettings &settings);
+
+        private:
+            static constexpr size_t MAX_MAPS = 8;
+
+            struct Entry {
+                uint64_t version;
+                size_t settings_hash;
+                map_renderer::RenderSettings settings;
+                std::shared_future<std::shared_ptr<const std::string>> map;
+            };
+
+            static std::shared_ptr<const std::string> RenderMap(const catalogue::TransportCatalogue &catalogue,
+                                                                const map_renderer::RenderSettings &settings);
+
+            std::mutex mutex_;
+            std::vector<Entry> entries_; // в порядке добавления
+        };
+
+    } // namespace request_handler
+} // namespace transport
@@ -72,34 +72,82 @@
 #include "map_renderer.h"
 
 #include <algorithm>
+#include <functional>
+#include <string>
 #include <utility>
 
 namespace transport {
     namespace map_renderer {
 
+        namespace {
+            void HashCombine(size_t &seed, size_t value) {
+                seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+            }
+
+            void HashPoint(size_t &seed, svg::Point point) {
+                HashCombine(seed, std::hash<double>{}(point.x));
+                HashCombine(seed, std::hash<double>{}(point.y));
+            }
+
+            void HashColor(size_t &seed, const svg::Color &color) {
+                HashCombine(seed, color.index());
+                if (const std::string *name = std::get_if<std::string>(&color)) {
+                    HashCombine(seed, std::hash<std::string>{}(*name));
+                } else if (const svg::Rgb *rgb = std::get_if<svg::Rgb>(&color)) {
+                    HashCombine(seed, (size_t{rgb->red} << 16) | (size_t{rgb->green} << 8) | rgb->blue);
+                } else if (const svg::Rgba *rgba = std::get_if<svg::Rgba>(&color)) {
+                    HashCombine(seed, (size_t{rgba->red} << 16) | (size_t{rgba->green} << 8) | rgba->blue);
+                    HashCombine(seed, std::hash<double>{}(rgba->opacity));
+                }
+            }
+        } // namespace
+
+        bool operator==(const RenderSettings &lhs, const RenderSettings &rhs) {
+            return lhs.width == rhs.width && lhs.height == rhs.height && lhs.padding == rhs.padding
+                && lhs.line_width == rhs.line_width && lhs.stop_radius == rhs.stop_radius
+                && lhs.bus_label_font_size == rhs.bus_label_font_size && lhs.bus_label_offset == rhs.bus_label_offset
+                && lhs.stop_label_font_size == rhs.stop_label_font_size && lhs.stop_label_offset == rhs.stop_label_offset
+                && lhs.underlayer_color == rhs.underlayer_color && lhs.underlayer_width == rhs.underlayer_width
+                && lhs.color_palette == rhs.color_palette;
+        }
+        bool operator!=(const RenderSettings &lhs, const RenderSettings &rhs) {
+            return !(lhs == rhs);
+        }
+
+        size_t RenderSettingsHasher::operator()(const RenderSettings &settings) const {
+            std::hash<double> double_hasher;
+            size_t seed = 0;
+            HashCombine(seed, double_hasher(settings.width));
+            HashCombine(seed, double_hasher(settings.height));
+            HashCombine(seed, double_hasher(settings.padding));
+            HashCombine(seed, double_hasher(settings.line_width));
+            HashCombine(seed, double_hasher(settings.stop_radius));
+            HashCombine(seed, static_cast<size_t>(settings.bus_label_font_size));
+            HashPoint(seed, settings.bus_label_offset);
+            HashCombine(seed, static_cast<size_t>(settings.stop_label_font_size));
+            HashPoint(seed, settings.stop_label_offset);
+            HashColor(seed, settings.underlayer_color);
+            HashCombine(seed, double_hasher(settings.underlayer_width));
+            for (const svg::Color &color : settings.color_palette) {
+                HashColor(seed, color);
+            }
+            return seed;
+        }
+
         svg::Document &MapRenderer::DrawMap() {
             using namespace catalogue;
 
-            all_stop_names_ = catalogue_.GetAllStopNames();
-            std::sort(all_stop_names_.begin(), all_stop_names_.end());
-
             std::vector<geo::Coordinates> all_coords;
-            all_coords.reserve(all_stop_names_.size());
+            all_coords.reserve(catalogue_.GetStopCount());
 
-            for (auto it = all_stop_names_.begin(); it != all_stop_names_.end(); ++it) {
-                const Stop* stop = catalogue_.FindStop(*it);
-                if (stop != nullptr) {
-                    all_coords.emplace_back(stop->location);
-                }
+            for (const Stop *stop : catalogue_.GetServedStopsByName()) {
+                all_coords.emplace_back(stop->location);
             }
             const geo::SphereProjector projector{
                         all_coords.begin(), all_coords.end(),
                         draw_settings_.width, draw_settings_.height, draw_settings_.padding
                     };
 
-            all_bus_names_ = catalogue_.GetAllBusNames();
-            std::sort(all_bus_names_.begin(), all_bus_names_.end());
-
             DrawBusLines(projector);
             DrawBusNames(projector);
             DrawStopCircles(projector);
@@ -115,8 +163,7 @@ namespace transport {
             size_t color_idx = 0;
             const size_t palette_color_last = draw_settings_.color_palette.size() - 1;
 
-            for (auto it = all_bus_names_.begin(); it != all_bus_names_.end(); ++it) {
-                const Bus *bus = catalogue_.FindBus(*it);
+            for (const Bus *bus : catalogue_.GetBusesByName()) {
                 if (!bus->stops.empty()) { // Линии маршрутов, на которых нет остановок, рисоваться не должны.
                     svg::Polyline polyline;
                     polyline.SetStrokeColor(draw_settings_.color_palette.at(color_idx));
@@ -125,7 +172,7 @@ namespace transport {
                     polyline.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
                     polyline.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
 
-                    for (const Stop *stop : bus->stops) {
+                    for (const Stop *stop : bus->GetRouteStops()) {
                         polyline.AddPoint(projector(stop->location));
                     }
                     map_picture_.Add(polyline);
@@ -142,15 +189,14 @@ namespace transport {
             size_t color_idx = 0;
             const size_t palette_color_last = draw_settings_.color_palette.size() - 1;
 
-            for (auto it = all_bus_names_.begin(); it != all_bus_names_.end(); ++it) {
-                const Bus *bus = catalogue_.FindBus(*it);
+            for (const Bus *bus : catalogue_.GetBusesByName()) {
                 if (!bus->stops.empty()) { // Маршруты, на которых нет остановок, рисоваться не должны.
                     svg::Text bus_text;
                     bus_text.SetOffset(draw_settings_.bus_label_offset);
                     bus_text.SetFontSize(static_cast<uint32_t>(draw_settings_.bus_label_font_size));
                     bus_text.SetFontFamily("Verdana"s);
                     bus_text.SetFontWeight("bold"s);
-                    bus_text.SetData(*it);
+                    bus_text.SetData(std::string(bus->name));
                     bus_text.SetPosition(projector(bus->stops.at(0)->location));
 
                     map_picture_.Add(svg::Text{bus_text} // подложка
@@ -163,7 +209,7 @@ namespace transport {
                     map_picture_.Add(svg::Text{bus_text}.SetFillColor(draw_settings_.color_palette.at(color_idx))); // надпись
 
                     if(!bus->is_roundtrip_) { // Если маршрут не кольцевой
-                        const Stop *stop2 = bus->stops.at(bus->stops.size() / 2);
+                        const Stop *stop2 = bus->stops.back();
                         if(*stop2 != *(bus->stops.at(0))) { // для хитрых не кольцевых маршрутов но с одинаковыми остановками на концах (в JSON)
                             bus_text.SetPosition(projector(stop2->location));
                             map_picture_.Add(svg::Text{bus_text} // подложка
@@ -189,11 +235,8 @@ namespace transport {
             circle.SetFillColor("white"s);
             circle.SetRadius(draw_settings_.stop_radius);
 
-            for (auto it = all_stop_names_.begin(); it != all_stop_names_.end(); ++it) {
-                const Stop *stop = catalogue_.FindStop(*it);
-                if(stop != nullptr) {
-                    map_picture_.Add(svg::Circle{circle}.SetCenter(projector(stop->location)));
-                }
+            for (const Stop *stop : catalogue_.GetServedStopsByName()) {
+                map_picture_.Add(svg::Circle{circle}.SetCenter(projector(stop->location)));
             }
         }
 
@@ -206,20 +249,17 @@ namespace transport {
             stop_text.SetFontSize(static_cast<uint32_t>(draw_settings_.stop_label_font_size));
             stop_text.SetFontFamily("Verdana"s);
 
-            for (auto it = all_stop_names_.begin(); it != all_stop_names_.end(); ++it) {
-                const Stop *stop = catalogue_.FindStop(*it);
-                if (stop != nullptr) {
-                    stop_text.SetPosition(projector(stop->location));
-                    stop_text.SetData(stop->name);
-                    map_picture_.Add(svg::Text{stop_text}  // подложка
-                                        .SetFillColor(draw_settings_.underlayer_color)
-                                        .SetStrokeColor(draw_settings_.underlayer_color)
-                                        .SetStrokeWidth(draw_settings_.underlayer_width)
-                                        .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
-                                        .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND)
-                                    );
-                    map_picture_.Add(svg::Text{stop_text}.SetFillColor("black"s));
-                }
+            for (const Stop *stop : catalogue_.GetServedStopsByName()) {
+                stop_text.SetPosition(projector(stop->location));
+                stop_text.SetData(std::string(stop->name));
+                map_picture_.Add(svg::Text{stop_text}  // подложка
+                                    .SetFillColor(draw_settings_.underlayer_color)
+                                    .SetStrokeColor(draw_settings_.underlayer_color)
+                                    .SetStrokeWidth(draw_settings_.underlayer_width)
+                                    .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
+                                    .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND)
+                                );
+                map_picture_.Add(svg::Text{stop_text}.SetFillColor("black"s));
             }
         }
 
@@ -3,6 +3,8 @@
 #include "svg.h"
 #include "transport_catalogue.h"
 
+#include <cstddef>
+
 namespace transport {
     namespace map_renderer {
 
@@ -22,6 +24,14 @@ namespace transport {
             std::vector<svg::Color> color_palette;
         };
 
+        bool operator==(const RenderSettings &lhs, const RenderSettings &rhs);
+        bool operator!=(const RenderSettings &lhs, const RenderSettings &rhs);
+
+        /* Хеш всех настроек отрисовки: вместе с версией снимка справочника он определяет карту (см. MapCache) */
+        struct RenderSettingsHasher {
+            size_t operator()(const RenderSettings &settings) const;
+        };
+
         class MapRenderer {
         public:
             MapRenderer(const catalogue::TransportCatalogue &catalogue, const RenderSettings &draw_settings)
@@ -37,8 +47,6 @@ namespace transport {
             const catalogue::TransportCatalogue &catalogue_;
             const RenderSettings &draw_settings_;
             svg::Document map_picture_;
-            std::vector<std::string> all_stop_names_; // отсортированный список остановок, через которые проходят маршруты
-            std::vector<std::string> all_bus_names_;  // отсортированный список маршрутов
         };
 
     } // namespace map_renderer
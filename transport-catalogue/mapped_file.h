@@ -0,0 +1,36 @@
+#pragma once
+/*
+ * Файл, отображённый в память только для чтения (mmap).
+ * 1) Содержимое файла доступно через GetData() без копирования в память процесса.
+ * 2) Отображение разделяемое (MAP_SHARED): несколько процессов, открывших один и тот же файл, используют одни и те же страницы памяти.
+ * 3) Отображение снимается в деструкторе. Объект не копируется, владение передаётся перемещением.
+ * При ошибке открытия или отображения файла выбрасывается std::runtime_error.
+ */
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace transport {
+
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string &path);
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        MappedFile(MappedFile &&other) noexcept;
+        MappedFile &operator=(MappedFile &&other) noexcept;
+        ~MappedFile();
+
+        std::string_view GetData() const {
+            return {data_, size_};
+        }
+
+    private:
+        void Unmap();
+
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+} // namespace transport
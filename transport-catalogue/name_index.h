@@ -0,0 +1,59 @@
+#pragma once
+/*
+ * Неизменяемый индекс имён для поиска по префиксу (подсказки при вводе названия остановки или маршрута).
+ * Хранит указатели на объекты (остановки или маршруты), отсортированные по полю name. Объекты с общим префиксом имени
+ * лежат в массиве подряд, поэтому начало диапазона находится двоичным поиском, а первые count совпадений - двоичным поиском
+ * внутри окна из count элементов. Результат - диапазон итераторов по массиву индекса, память при поиске не выделяется.
+ */
+#include "ranges.h"
+
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+namespace transport {
+    namespace catalogue {
+
+        template <typename Item>
+        class NameIndex {
+        public:
+            using Iterator = typename std::vector<const Item *>::const_iterator;
+
+            NameIndex() = default;
+
+            /* items - контейнер объектов с полем std::string_view name, объекты должны жить дольше индекса */
+            template <typename Container>
+            explicit NameIndex(const Container &items) {
+                items_.reserve(items.size());
+                for (const Item &item : items) {
+                    items_.push_back(&item);
+                }
+                std::sort(items_.begin(), items_.end(), [](const Item *lhs, const Item *rhs) { return lhs->name < rhs->name; });
+            }
+
+            /* Не более count объектов, имя которых начинается с prefix, в лексикографическом порядке имён */
+            ranges::Range<Iterator> FindByPrefix(std::string_view prefix, size_t count) const {
+                const Iterator first = std::lower_bound(items_.begin(), items_.end(), prefix,
+                                                        [](const Item *item, std::string_view value) { return item->name < value; });
+                const Iterator window_end = first + static_cast<std::ptrdiff_t>(std::min<size_t>(count, items_.end() - first));
+                const Iterator last = std::partition_point(first, window_end, [prefix](const Item *item) {
+                    return item->name.substr(0, prefix.size()) == prefix;
+                });
+                return {first, last};
+            }
+
+            /* Все объекты в лексикографическом порядке имён */
+            ranges::Range<Iterator> GetAll() const {
+                return ranges::AsRange(items_);
+            }
+
+            size_t GetSize() const {
+                return items_.size();
+            }
+
+        private:
+            std::vector<const Item *> items_;
+        };
+
+    } // конец namespace catalogue
+} // конец namespace transport
@@ -3,84 +3,168 @@
  */
 #include "request_handler.h"
 
+#include <algorithm>
 #include <optional>
 #include <sstream>
+#include <string_view>
+#include <thread>
 #include <variant>
 
 namespace transport {
     namespace request_handler {
 
-       json::Document RequestHandler::GetStatistics() {
-            using namespace catalogue;
+        WorkStealingPool *SharedResources::GetPool() {
+            std::call_once(pool_once_, [this] {
+                if (const size_t threads_num = std::thread::hardware_concurrency(); threads_num > 1) {
+                    pool_ = std::make_unique<WorkStealingPool>(threads_num);
+                }
+            });
+            return pool_.get();
+        }
+
+        void RequestHandler::WriteStatistics(json::Writer &writer) {
             using namespace json;
-            using namespace json_reader;
-            using namespace transport_router;
 
-            Builder answer_arr;
+            catalogue_ = catalogue_holder_.Get();
+
+            // маршрутизатор строится в фоне, пока выводятся ответы на запросы до первого Route
+            const bool has_route_requests = std::any_of(requests_.begin(), requests_.end(), [this](const json_reader::StatRequest &req) {
+                return req.type == str_route_;
+            });
+            if (has_route_requests) {
+                resources_.GetRouterCache().Prepare(catalogue_, router_settings_);
+            }
+
+            StreamBuilder answer_arr(writer);
             answer_arr.StartArray();
 
-            for(const StatRequest& req : requests_) {
-                if (req.type == str_bus_type_) {
-                    BusStatRequest(req, answer_arr);
-                } else if (req.type == str_stop_type_) {
-                    StopStatRequest(req, answer_arr);
-                } else if (req.type == str_map_type_) {
-                    MapStatRequest(req, answer_arr);
-                } else if (req.type == str_route_) {
-                    if (route_builder_ == nullptr) {
-                        route_builder_ = new RouteBuilder(catalogue_, router_settings_);
-                    }
-                    RouteStatRequest(req, answer_arr);
+            WorkStealingPool *pool = requests_.size() >= MIN_PARALLEL_REQUESTS && writer.GetFormat() == Writer::Format::COMPACT
+                                     ? resources_.GetPool() : nullptr;
+            if (pool != nullptr) {
+                WriteStatisticsParallel(*pool, answer_arr);
+            } else {
+                for (const json_reader::StatRequest &req : requests_) {
+                    WriteAnswer(req, answer_arr);
                 }
             }
             answer_arr.EndArray();
+        }
+
+        void RequestHandler::WriteStatisticsParallel(WorkStealingPool &pool, json::StreamBuilder &answer_arr) {
+            using namespace json;
+
+            /* Буфер ответов одного потока */
+            struct WorkerOutput {
+                std::ostringstream text;
+                Writer writer{text, Writer::Format::COMPACT};
+            };
+            /* Где лежит ответ на запрос: поток и отрезок его буфера */
+            struct AnswerText {
+                size_t worker_idx = 0;
+                size_t begin = 0;
+                size_t end = 0;
+            };
 
-            if (route_builder_ != nullptr) {
-                delete route_builder_;
+            std::vector<std::unique_ptr<WorkerOutput>> outputs;
+            for (size_t i = 0; i != pool.GetThreadCount(); ++i) {
+                outputs.push_back(std::make_unique<WorkerOutput>());
             }
+            std::vector<AnswerText> answers;
+            std::vector<std::string> texts(outputs.size());
 
-            return Document(answer_arr.Build());
+            for (size_t round_begin = 0; round_begin < requests_.size(); round_begin += REQUESTS_PER_ROUND) {
+                const size_t round_end = std::min(round_begin + REQUESTS_PER_ROUND, requests_.size());
+                answers.assign(round_end - round_begin, AnswerText{});
+
+                const size_t task_count = (round_end - round_begin + REQUESTS_PER_TASK - 1) / REQUESTS_PER_TASK;
+                pool.ParallelFor(task_count, [&](size_t worker_idx, size_t task_idx) {
+                    WorkerOutput &output = *outputs[worker_idx];
+                    const size_t task_begin = round_begin + task_idx * REQUESTS_PER_TASK;
+                    const size_t task_end = std::min(task_begin + REQUESTS_PER_TASK, round_end);
+                    for (size_t idx = task_begin; idx != task_end; ++idx) {
+                        AnswerText &answer = answers[idx - round_begin];
+                        answer.worker_idx = worker_idx;
+                        answer.begin = static_cast<size_t>(output.text.tellp());
+                        {
+                            StreamBuilder answer_builder(output.writer);
+                            WriteAnswer(requests_[idx], answer_builder);
+                        }
+                        output.writer.Flush();
+                        answer.end = static_cast<size_t>(output.text.tellp());
+                    }
+                });
+
+                for (size_t i = 0; i != outputs.size(); ++i) {
+                    texts[i] = outputs[i]->text.str();
+                    outputs[i]->text.str({});
+                }
+                for (const AnswerText &answer : answers) {
+                    if (answer.begin != answer.end) {
+                        answer_arr.RawValue(std::string_view(texts[answer.worker_idx]).substr(answer.begin, answer.end - answer.begin));
+                    }
+                }
+            }
+        }
+
+        void RequestHandler::WriteAnswer(const json_reader::StatRequest &req, json::StreamBuilder &answer) {
+            if (req.type == str_bus_type_) {
+                BusStatRequest(req, answer);
+            } else if (req.type == str_stop_type_) {
+                StopStatRequest(req, answer);
+            } else if (req.type == str_map_type_) {
+                MapStatRequest(req, answer);
+            } else if (req.type == str_route_) {
+                RouteStatRequest(req, answer);
+            } else if (req.type == str_nearest_stops_type_) {
+                NearestStopsStatRequest(req, answer);
+            } else if (req.type == str_stops_in_box_type_) {
+                StopsInBoxStatRequest(req, answer);
+            } else if (req.type == str_autocomplete_type_) {
+                AutocompleteStatRequest(req, answer);
+            } else if (req.type == str_segment_type_) {
+                SegmentStatRequest(req, answer);
+            }
         }
 
-        void RequestHandler::BusStatRequest(const json_reader::StatRequest &req, json::Builder &answer_arr) {
+        void RequestHandler::BusStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr) {
             using namespace catalogue;
             using namespace json;
             using namespace json_reader;
 
-            std::optional<BusStatistics> bus_info = catalogue_.GetBusStatistics(req.name);
+            std::optional<BusStatistics> bus_info = catalogue_->GetBusStatistics(req.name);
 
             answer_arr.StartDict();
             if (bus_info.has_value()) {
                 answer_arr.Key(str_bus_curvature_).Value(static_cast<double>(bus_info->curvature))
                         .Key(str_request_id_).Value(req.id)
-                        .Key(str_bus_route_).Value(static_cast<double>(bus_info->distance))
+                        .Key(str_bus_route_).Value(static_cast<int>(bus_info->distance))
                         .Key(str_bus_stop_cnt_).Value(static_cast<int>(bus_info->stops_num))
                         .Key(str_bus_stop_unique_).Value(static_cast<int>(bus_info->uniq_stops_num));
             } else {
-                answer_arr.Key(str_request_id_).Value(req.id)
-                        .Key(str_error_).Value(str_error_string_);
+                answer_arr.Key(str_error_).Value(str_error_string_)
+                        .Key(str_request_id_).Value(req.id);
             }
             answer_arr.EndDict();
         }
 
-        void RequestHandler::StopStatRequest(const json_reader::StatRequest &req, json::Builder &answer_arr) {
+        void RequestHandler::StopStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr) {
             using namespace catalogue;
             using namespace json;
             using namespace json_reader;
 
-            std::optional<std::vector<std::string>> stop_info = catalogue_.GetStopStatistics(req.name);
+            std::optional<std::vector<std::string_view>> stop_info = catalogue_->GetStopStatistics(req.name);
 
             answer_arr.StartDict();
             if (!stop_info.has_value()) {
-                answer_arr.Key(str_request_id_).Value(req.id)
-                        .Key(str_error_).Value(str_error_string_);
+                answer_arr.Key(str_error_).Value(str_error_string_)
+                        .Key(str_request_id_).Value(req.id);
             } else if (stop_info.value().empty()) {
                 answer_arr.Key(str_stop_buses_).StartArray().EndArray()
                         .Key(str_request_id_).Value(req.id);
             } else {
                 answer_arr.Key(str_stop_buses_).StartArray();
 
-                for (const std::string &bus : stop_info.value()) {
+                for (std::string_view bus : stop_info.value()) {
                     answer_arr.Value(bus);
                 }
 
@@ -90,59 +174,126 @@ namespace transport {
             answer_arr.EndDict();
         }
 
-        void RequestHandler::MapStatRequest(const json_reader::StatRequest &req, json::Builder &answer_arr) {
+        void RequestHandler::MapStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr) {
             using namespace catalogue;
             using namespace json;
             using namespace transport_router;
 
-            map_renderer::MapRenderer map_drawer(catalogue_, draw_settings_);
-            svg::Document &map_picture = map_drawer.DrawMap();
-            std::ostringstream out;
-            map_picture.Render(out);
+            const std::shared_ptr<const std::string> map = resources_.GetMapCache().GetMap(*catalogue_, draw_settings_);
 
+            // карта в кэше уже записана как строка JSON
             answer_arr.StartDict()
-                        .Key(str_map_answer_).Value(out.str())
+                        .Key(str_map_answer_).RawValue(*map)
                         .Key(str_request_id_).Value(req.id)
                     .EndDict();
         }
 
-        void RequestHandler::RouteStatRequest(const json_reader::StatRequest &req, json::Builder &answer_arr) {
+        void RequestHandler::RouteStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr) {
             using namespace catalogue;
             using namespace json;
             using namespace transport_router;
 
-            std::optional<FoundRouteResult> found_route = route_builder_->FindRoute(req.from, req.to);
+            // маршрутизатор может ещё строиться в фоне (RouterCache::Prepare): ждёт только запрос Route
+            const std::shared_ptr<const RouteBuilder> route_builder = resources_.GetRouterCache().GetRouter(catalogue_, router_settings_);
+            std::optional<FoundRouteResult> found_route = route_builder->FindRoute(req.from, req.to);
 
             answer_arr.StartDict();
             if (!found_route.has_value()) {
-                answer_arr.Key(str_request_id_).Value(req.id)
-                            .Key(str_error_).Value(str_error_string_);
+                answer_arr.Key(str_error_).Value(str_error_string_)
+                            .Key(str_request_id_).Value(req.id);
             } else {
-                answer_arr.Key(str_request_id_).Value(req.id)
-                            .Key(str_total_time_).Value(found_route->total_time)
-                            .Key(str_items_).StartArray();
+                answer_arr.Key(str_items_).StartArray();
                 for (auto& item : found_route->route) {
                     answer_arr.StartDict();
                     if (std::holds_alternative<FoundRouteResult::Wait>(item)) {
                         // wait
                         FoundRouteResult::Wait wait = std::get<FoundRouteResult::Wait>(item);
-                        answer_arr.Key(str_type_).Value(str_type_wait_)
-                                    .Key(str_stop_name_).Value(wait.stop)
-                                    .Key(str_time_).Value(wait.time);
+                        answer_arr.Key(str_stop_name_).Value(wait.stop)
+                                    .Key(str_time_).Value(wait.time)
+                                    .Key(str_type_).Value(str_type_wait_);
                     } else {
                         // bus
                         FoundRouteResult::Bus bus = std::get<FoundRouteResult::Bus>(item);
-                        answer_arr.Key(str_type_).Value(str_type_bus_)
-                                    .Key(str_bus_).Value(bus.bus)
+                        answer_arr.Key(str_bus_).Value(bus.bus)
                                     .Key(str_span_count_).Value(static_cast<int>(bus.span_count))
-                                    .Key(str_time_).Value(bus.time);
+                                    .Key(str_time_).Value(bus.time)
+                                    .Key(str_type_).Value(str_type_bus_);
                     }
                     answer_arr.EndDict();
                 }
-                answer_arr.EndArray();
+                answer_arr.EndArray()
+                            .Key(str_request_id_).Value(req.id)
+                            .Key(str_total_time_).Value(found_route->total_time);
             }
             answer_arr.EndDict();
         }
+        void RequestHandler::NearestStopsStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr) {
+            using namespace catalogue;
+
+            answer_arr.StartDict()
+                        .Key(str_request_id_).Value(req.id)
+                        .Key(str_stops_).StartArray();
+            for (const NearStop &near_stop : catalogue_->NearestStops(req.point, req.count)) {
+                answer_arr.StartDict()
+                            .Key(str_distance_).Value(near_stop.distance)
+                            .Key(str_name_).Value(near_stop.stop->name)
+                        .EndDict();
+            }
+            answer_arr.EndArray()
+                    .EndDict();
+        }
+
+        void RequestHandler::StopsInBoxStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr) {
+            using namespace catalogue;
+
+            answer_arr.StartDict()
+                        .Key(str_request_id_).Value(req.id)
+                        .Key(str_stops_).StartArray();
+            for (const Stop *stop : catalogue_->StopsInBox(req.box_min, req.box_max)) {
+                answer_arr.Value(stop->name);
+            }
+            answer_arr.EndArray()
+                    .EndDict();
+        }
+
+        void RequestHandler::AutocompleteStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr) {
+            using namespace catalogue;
+
+            answer_arr.StartDict()
+                        .Key(str_stop_buses_).StartArray();
+            for (const Bus *bus : catalogue_->FindBusesByPrefix(req.prefix, req.count)) {
+                answer_arr.Value(bus->name);
+            }
+            answer_arr.EndArray()
+                        .Key(str_request_id_).Value(req.id)
+                        .Key(str_stops_).StartArray();
+            for (const Stop *stop : catalogue_->FindStopsByPrefix(req.prefix, req.count)) {
+                answer_arr.Value(stop->name);
+            }
+            answer_arr.EndArray()
+                    .EndDict();
+        }
+
+        void RequestHandler::SegmentStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr) {
+            using namespace catalogue;
+
+            const Bus *bus = catalogue_->FindBus(req.name);
+
+            answer_arr.StartDict();
+            if (bus != nullptr && req.from_position <= req.to_position && req.to_position < bus->GetRouteStopCount()) {
+                const DistanceBetweenStops segment = catalogue_->GetSegmentDistance(bus, req.from_position, req.to_position);
+                answer_arr.Key(str_geo_length_).Value(segment.geographic)
+                        .Key(str_request_id_).Value(req.id)
+                        .Key(str_bus_route_).Value(static_cast<int>(segment.measured))
+                        .Key(str_span_count_).Value(static_cast<int>(req.to_position - req.from_position))
+                        .Key(str_time_).Value(router_settings_.GetTravelTime(segment.measured));
+            } else {
+                answer_arr.Key(str_error_).Value(str_error_string_)
+                        .Key(str_request_id_).Value(req.id);
+            }
+            answer_arr.EndDict();
+        }
+
     } // namespace request_handler
 
 } // namespace transport
\ No newline at end of file
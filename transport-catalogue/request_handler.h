@@ -14,6 +14,8 @@
  * В выходном JSON-массиве на каждый запрос stat_requests должен быть ответ в виде словаря с обязательным ключом request_id.
  * Значение ключа должно быть равно id соответствующего запроса. В словаре возможны и другие ключи, специфичные для конкретного типа ответа.
  * Порядок следования ответов на запросы в выходном массиве должен совпадать с порядком запросов в массиве stat_requests.
+ * Ключи словарей ответа выводятся в лексикографическом порядке. Ответ пишется потоком (json::StreamBuilder), который не сортирует ключи,
+ * поэтому обработчики запросов вызывают Key именно в этом порядке.
  *
  * 1) Получение информации о маршруте. Формат запроса:
  * {
@@ -119,41 +121,174 @@
  *     "request_id": <id запроса>,
  *     "error_message": "not found"
  * }
+ *
+ * 5) Поиск ближайших к точке остановок. Формат запроса:
+ * {
+ *   "id": 7,
+ *   "type": "NearestStops",
+ *   "latitude": 43.587795,
+ *   "longitude": 39.716901,
+ *   "count": 2
+ * }
+ * - latitude и longitude — координаты точки;
+ * - count — сколько ближайших остановок нужно найти.
+ * Ответ на запрос:
+ * {
+ *   "request_id": 7,
+ *   "stops": [
+ *       {"distance": 120.4, "name": "Морской вокзал"},
+ *       {"distance": 1893.2, "name": "Ривьерский мост"}
+ *   ]
+ * }
+ * - stops — не более count остановок, отсортированных по возрастанию расстояния до точки (distance, в метрах, по дуге большого круга).
+ *
+ * 6) Поиск остановок внутри прямоугольника. Формат запроса:
+ * {
+ *   "id": 8,
+ *   "type": "StopsInBox",
+ *   "min_latitude": 43.58,
+ *   "min_longitude": 39.71,
+ *   "max_latitude": 43.60,
+ *   "max_longitude": 39.75
+ * }
+ * Если min_longitude больше max_longitude, прямоугольник считается пересекающим 180-й меридиан.
+ * Ответ на запрос:
+ * {
+ *   "request_id": 8,
+ *   "stops": ["Морской вокзал", "Ривьерский мост"]
+ * }
+ * - stops — названия остановок, у которых широта и долгота лежат в заданных пределах, в лексикографическом порядке.
+ *
+ * 7) Подсказки по началу названия остановки или маршрута. Формат запроса:
+ * {
+ *   "id": 9,
+ *   "type": "Autocomplete",
+ *   "prefix": "Мор",
+ *   "count": 5
+ * }
+ * Ответ на запрос:
+ * {
+ *   "buses": [],
+ *   "request_id": 9,
+ *   "stops": ["Морской вокзал"]
+ * }
+ * - buses и stops — не более count названий маршрутов и остановок, начинающихся с prefix, в лексикографическом порядке.
+ *
+ * 8) Длина и время проезда участка маршрута. Формат запроса:
+ * {
+ *   "id": 10,
+ *   "type": "Segment",
+ *   "name": "14",
+ *   "from_position": 1,
+ *   "to_position": 3
+ * }
+ * - name — название маршрута;
+ * - from_position и to_position — номера остановок (с нуля) в полной последовательности остановок маршрута,
+ * для некольцевого маршрута - туда и обратно (как в ответе stop_count запроса Bus), from_position <= to_position.
+ * Ответ на запрос:
+ * {
+ *   "geo_length": 2540.5,
+ *   "request_id": 10,
+ *   "route_length": 3100,
+ *   "span_count": 2,
+ *   "time": 4.65
+ * }
+ * - geo_length — длина участка по географическим координатам в метрах;
+ * - route_length — дорожная длина участка в метрах;
+ * - span_count — количество перегонов между остановками на участке;
+ * - time — время проезда участка в минутах со скоростью bus_velocity, без ожиданий.
+ * Если маршрута нет или номера остановок вне маршрута, ответ содержит "error_message": "not found".
  */
 
+#include "catalogue_snapshot.h"
 #include "json.h"
 #include "json_builder.h"
 #include "json_reader.h"
+#include "map_cache.h"
+#include "thread_pool.h"
 #include "transport_catalogue.h"
 #include "transport_router.h"
 
+#include <memory>
+#include <mutex>
 #include <string>
 
+/*
+ * Обработчик берёт текущий снимок справочника из CatalogueSnapshotHolder в начале WriteStatistics и держит его до конца пачки запросов,
+ * поэтому публикация нового справочника во время ответа на запросы не блокирует обработчик и не меняет данные посреди пачки.
+ * Маршрутизатор (RouterCache) и карты (MapCache) берутся из SharedResources, которые переживают обработчик:
+ * маршрутизатор строится один раз на снимок, карта - один раз на снимок и настройки.
+ * Маршрутизатор может ещё строиться в фоне (RouterCache::Prepare): его ждут только запросы Route, остальные отвечаются сразу.
+ *
+ * Большие пачки запросов выполняются параллельно (при выводе в формате json::Writer::Format::COMPACT):
+ * 1) снимок справочника и настройки только читаются, маршрутизатор и карты берутся из потокобезопасных кэшей;
+ * 2) запросы делятся на задачи по REQUESTS_PER_TASK подряд и выполняются в общем пуле WorkStealingPool;
+ * 3) каждый поток пишет ответы в свой буфер и запоминает, где лежит ответ на каждый запрос;
+ * 4) ответы выводятся в порядке запросов. Запросы обрабатываются раундами по REQUESTS_PER_ROUND,
+ * поэтому в памяти одновременно лежат ответы только одного раунда.
+ */
 namespace transport {
     namespace request_handler {
 
+        /*
+         * Общие для всех обработчиков запросов процесса данные: кэш карт, маршрутизатор текущего снимка и пул потоков.
+         * Методы потокобезопасны: обработчики из разных потоков (режим сервера) пользуются ими одновременно.
+         */
+        class SharedResources {
+        public:
+            MapCache &GetMapCache() {
+                return map_cache_;
+            }
+            transport_router::RouterCache &GetRouterCache() {
+                return router_cache_;
+            }
+            /* Пул создаётся при первом обращении; nullptr, если у машины один аппаратный поток */
+            WorkStealingPool *GetPool();
+
+        private:
+            MapCache map_cache_;
+            transport_router::RouterCache router_cache_;
+            std::once_flag pool_once_;
+            std::unique_ptr<WorkStealingPool> pool_;
+        };
+
         class RequestHandler {
         public:
             RequestHandler(const std::vector<json_reader::StatRequest> requests,
-                            const catalogue::TransportCatalogue &catalogue,
+                            const catalogue::CatalogueSnapshotHolder &catalogue_holder,
                             const map_renderer::RenderSettings &draw_settings,
-                            const transport_router::RouterSetting &router_settings)
-                : requests_(requests), catalogue_(catalogue),
-                draw_settings_(draw_settings), router_settings_(router_settings) {}
+                            const transport_router::RouterSetting &router_settings,
+                            SharedResources &resources)
+                : requests_(requests), catalogue_holder_(catalogue_holder),
+                draw_settings_(draw_settings), router_settings_(router_settings), resources_(resources) {}
 
-            json::Document GetStatistics();
+            /* Ответы выводятся в writer по мере выполнения запросов, без построения документа в памяти */
+            void WriteStatistics(json::Writer &writer);
 
         private:
-            void BusStatRequest(const json_reader::StatRequest &req, json::Builder &answer_arr);
-            void StopStatRequest(const json_reader::StatRequest &req, json::Builder &answer_arr);
-            void MapStatRequest(const json_reader::StatRequest &req, json::Builder &answer_arr);
-            void RouteStatRequest(const json_reader::StatRequest &req, json::Builder &answer_arr);
+            static constexpr size_t MIN_PARALLEL_REQUESTS = 256;
+            static constexpr size_t REQUESTS_PER_TASK = 16;
+            static constexpr size_t REQUESTS_PER_ROUND = 16 * 1024;
+
+            void WriteStatisticsParallel(WorkStealingPool &pool, json::StreamBuilder &answer_arr);
+            /* Ответ на запрос req - словарь, выводимый в answer (на запрос неизвестного типа ничего не выводится) */
+            void WriteAnswer(const json_reader::StatRequest &req, json::StreamBuilder &answer);
+
+            void BusStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr);
+            void StopStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr);
+            void MapStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr);
+            void RouteStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr);
+            void NearestStopsStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr);
+            void StopsInBoxStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr);
+            void AutocompleteStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr);
+            void SegmentStatRequest(const json_reader::StatRequest &req, json::StreamBuilder &answer_arr);
 
             const std::vector<json_reader::StatRequest> requests_;
-            const catalogue::TransportCatalogue &catalogue_;
+            const catalogue::CatalogueSnapshotHolder &catalogue_holder_;
+            std::shared_ptr<const catalogue::TransportCatalogue> catalogue_; // снимок справочника для текущей пачки запросов
             const map_renderer::RenderSettings &draw_settings_;
             const transport_router::RouterSetting &router_settings_;
-            transport_router::RouteBuilder *route_builder_ = nullptr;
+            SharedResources &resources_;
 
             const std::string str_request_id_ = "request_id";
             const std::string str_type_ = "type";
@@ -182,6 +317,16 @@ namespace transport {
             const std::string str_time_ = "time";
             const std::string str_span_count_ = "span_count";
             const std::string str_stop_name_ = "stop_name";
+
+            const std::string str_nearest_stops_type_ = "NearestStops";
+            const std::string str_stops_in_box_type_ = "StopsInBox";
+            const std::string str_stops_ = "stops";
+            const std::string str_distance_ = "distance";
+
+            const std::string str_autocomplete_type_ = "Autocomplete";
+
+            const std::string str_segment_type_ = "Segment";
+            const std::string str_geo_length_ = "geo_length";
         };
 
     } // namespace request_handler
@@ -0,0 +1,258 @@
+/* сервер запросов к справочнику на сокетах POSIX */
+#include "server.h"
+#include "catalogue_serialization.h"
+#include "json_builder.h"
+#include "json_reader.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <netinet/in.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace transport {
+    namespace server {
+
+        namespace {
+            /* Счётчики выводятся целыми числами JSON, которые ограничены int */
+            int ToJsonInt(uint64_t value) {
+                return static_cast<int>(std::min<uint64_t>(value, INT_MAX));
+            }
+
+            bool SendAll(int socket_fd, std::string_view data) {
+                while (!data.empty()) {
+                    const ssize_t sent = ::send(socket_fd, data.data(), data.size(), MSG_NOSIGNAL);
+                    if (sent < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        return false;
+                    }
+                    data.remove_prefix(static_cast<size_t>(sent));
+                }
+                return true;
+            }
+
+            [[noreturn]] void ThrowSocketError(const std::string &action, const std::string &address) {
+                throw std::runtime_error("Cannot " + action + " " + address + ": " + std::strerror(errno));
+            }
+        } // namespace
+
+        Server::Server(catalogue::CatalogueSnapshotHolder &catalogue, const map_renderer::RenderSettings &draw_settings,
+                       const transport_router::RouterSetting &router_settings)
+            : catalogue_(catalogue), draw_settings_(draw_settings), router_settings_(router_settings),
+            start_time_(std::chrono::steady_clock::now()) {
+        }
+
+        void Server::Run(const std::string &address) {
+            const int listen_fd = Listen(address);
+
+            // маршрутизатор строится в фоне до первого запроса Route, соединения принимаются сразу
+            resources_.GetRouterCache().Prepare(catalogue_.Get(), router_settings_);
+
+            while (true) {
+                const int socket_fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+                if (socket_fd < 0) {
+                    if (errno == EINTR || errno == ECONNABORTED || errno == EMFILE || errno == ENFILE) {
+                        continue;
+                    }
+                    ThrowSocketError("accept connection on", address);
+                }
+                ++stats_.connections;
+                std::thread(&Server::ServeConnection, this, socket_fd).detach();
+            }
+        }
+
+        int Server::Listen(const std::string &address) {
+            const bool is_port = !address.empty() && address.size() <= 5
+                                 && std::all_of(address.begin(), address.end(), [](char c) { return c >= '0' && c <= '9'; });
+            int listen_fd = -1;
+            if (is_port) {
+                const int port = std::stoi(address);
+                if (port > 65535) {
+                    throw std::runtime_error("Invalid port " + address);
+                }
+                listen_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if (listen_fd < 0) {
+                    ThrowSocketError("create socket for", address);
+                }
+                const int reuse = 1;
+                ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+                sockaddr_in socket_address {};
+                socket_address.sin_family = AF_INET;
+                socket_address.sin_port = htons(static_cast<uint16_t>(port));
+                socket_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                if (::bind(listen_fd, reinterpret_cast<const sockaddr *>(&socket_address), sizeof(socket_address)) != 0) {
+                    ThrowSocketError("bind", address);
+                }
+            } else {
+                sockaddr_un socket_address {};
+                if (address.empty() || address.size() >= sizeof(socket_address.sun_path)) {
+                    throw std::runtime_error("Invalid socket path " + address);
+                }
+                listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if (listen_fd < 0) {
+                    ThrowSocketError("create socket for", address);
+                }
+                socket_address.sun_family = AF_UNIX;
+                std::copy(address.begin(), address.end(), socket_address.sun_path);
+                ::unlink(address.c_str()); // сокет, оставшийся от прежнего запуска
+                if (::bind(listen_fd, reinterpret_cast<const sockaddr *>(&socket_address), sizeof(socket_address)) != 0) {
+                    ThrowSocketError("bind", address);
+                }
+            }
+            if (::listen(listen_fd, SOMAXCONN) != 0) {
+                ThrowSocketError("listen on", address);
+            }
+            return listen_fd;
+        }
+
+        void Server::ServeConnection(int socket_fd) {
+            static constexpr size_t READ_SIZE = 64 * 1024;
+
+            std::string buffer;
+            size_t scanned = 0; // начало буфера, в котором перевода строки уже нет
+            std::unique_ptr<char[]> chunk(new char[READ_SIZE]);
+            while (true) {
+                const ssize_t received = ::recv(socket_fd, chunk.get(), READ_SIZE, 0);
+                if (received < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (received <= 0) {
+                    break;
+                }
+                buffer.append(chunk.get(), static_cast<size_t>(received));
+
+                size_t line_begin = 0;
+                for (size_t line_end = buffer.find('\n', scanned); line_end != std::string::npos; line_end = buffer.find('\n', line_begin)) {
+                    std::string_view line(buffer.data() + line_begin, line_end - line_begin);
+                    line_begin = line_end + 1;
+                    if (!line.empty() && line.back() == '\r') {
+                        line.remove_suffix(1);
+                    }
+                    if (line.find_first_not_of(" \t") == std::string_view::npos) {
+                        continue;
+                    }
+
+                    const auto start = std::chrono::steady_clock::now();
+                    std::string answer = AnswerLine(line);
+                    answer.push_back('\n');
+                    if (!SendAll(socket_fd, answer)) {
+                        ::close(socket_fd);
+                        return;
+                    }
+                    AddLatency(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start).count()));
+                }
+                buffer.erase(0, line_begin);
+                scanned = buffer.size();
+
+                if (buffer.size() > MAX_LINE_SIZE) {
+                    // дочитывать такую строку до конца пришлось бы в память целиком, поэтому соединение закрывается
+                    ++stats_.errors;
+                    SendAll(socket_fd, ErrorAnswer("Line is longer than " + std::to_string(MAX_LINE_SIZE) + " bytes") + '\n');
+                    break;
+                }
+            }
+            ::close(socket_fd);
+        }
+
+        std::string Server::AnswerLine(std::string_view line) {
+            std::ostringstream out;
+            try {
+                json_reader::JsonReader reader;
+                const json::Document document = json::Load(line, &reader.GetKeyTable());
+                const json::Dict root = document.GetRoot().AsMap();
+
+                json::Writer writer(out, json::Writer::Format::COMPACT);
+                if (root.count(str_type_) && root.at(str_type_).AsString() == str_server_stats_type_) {
+                    WriteServerStats(root.at(str_id_).AsInt(), writer);
+                } else if (root.count(str_type_) && root.at(str_type_).AsString() == str_reload_type_) {
+                    Reload(root, writer);
+                } else {
+                    const std::vector<json_reader::StatRequest> &requests = reader.FillStatRequests(document);
+                    request_handler::RequestHandler handler(requests, catalogue_, draw_settings_, router_settings_, resources_);
+                    handler.WriteStatistics(writer);
+                    ++stats_.batches;
+                    stats_.requests += requests.size();
+                }
+            } catch (const std::exception &error) {
+                // недописанный ответ отбрасывается
+                ++stats_.errors;
+                return ErrorAnswer(error.what());
+            }
+            return out.str();
+        }
+
+        std::string Server::ErrorAnswer(std::string_view message) const {
+            std::ostringstream out;
+            {
+                json::Writer writer(out, json::Writer::Format::COMPACT);
+                json::StreamBuilder(writer).StartDict().Key(str_error_).Value(message).EndDict();
+            }
+            return out.str();
+        }
+
+        void Server::WriteServerStats(int id, json::Writer &writer) const {
+            const double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count();
+            const uint64_t requests = stats_.requests;
+            const uint64_t lines = stats_.lines;
+            const double average_latency = lines == 0 ? 0.0 : static_cast<double>(stats_.total_latency) / static_cast<double>(lines) / 1000.0;
+
+            json::StreamBuilder(writer).StartDict()
+                        .Key(str_request_id_).Value(id)
+                        .Key(str_uptime_).Value(uptime)
+                        .Key(str_connections_).Value(ToJsonInt(stats_.connections))
+                        .Key(str_batches_).Value(ToJsonInt(stats_.batches))
+                        .Key(str_requests_).Value(ToJsonInt(requests))
+                        .Key(str_errors_).Value(ToJsonInt(stats_.errors))
+                        .Key(str_requests_per_second_).Value(uptime > 0 ? static_cast<double>(requests) / uptime : 0.0)
+                        .Key(str_average_latency_).Value(average_latency)
+                        .Key(str_max_latency_).Value(static_cast<double>(stats_.max_latency) / 1000.0)
+                    .EndDict();
+        }
+
+        void Server::Reload(const json::Dict &request, json::Writer &writer) {
+            const int id = request.at(str_id_).AsInt();
+            std::lock_guard lock(reload_mutex_);
+
+            std::shared_ptr<const catalogue::TransportCatalogue> snapshot;
+            if (request.count(str_snapshot_)) {
+                snapshot = serialization::LoadCatalogue(std::string(request.at(str_snapshot_).AsString()));
+            } else {
+                const MappedFile input(std::string(request.at(str_input_).AsString()));
+                json_reader::JsonReader reader;
+                catalogue::CatalogueBuilder builder;
+                reader.FillTransportCatalogue(input.GetData(), builder);
+                snapshot = builder.Build();
+            }
+            catalogue_.Publish(snapshot);
+            resources_.GetRouterCache().Prepare(snapshot, router_settings_);
+
+            json::StreamBuilder(writer).StartDict()
+                        .Key(str_request_id_).Value(id)
+                        .Key(str_version_).Value(ToJsonInt(snapshot->GetVersion()))
+                    .EndDict();
+        }
+
+        void Server::AddLatency(uint64_t latency) {
+            ++stats_.lines;
+            stats_.total_latency += latency;
+            uint64_t max_latency = stats_.max_latency;
+            while (latency > max_latency && !stats_.max_latency.compare_exchange_weak(max_latency, latency)) {
+            }
+        }
+
+    } // namespace server
+} // namespace transport
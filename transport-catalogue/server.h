@@ -0,0 +1,104 @@
+#pragma once
+/*
+ * Режим сервера: справочник, настройки и маршрутизатор загружаются один раз, после чего сервер отвечает на пачки запросов
+ * из соединений клиентов, пока процесс не остановят.
+ * 1) Адрес (Run): номер порта TCP (слушается только 127.0.0.1) или путь Unix-сокета (существующий файл сокета заменяется).
+ * 2) Протокол построчный, каждая строка клиента - JSON-словарь, ответ на неё - одна строка компактного JSON:
+ *    - {"stat_requests": [...]} - пачка запросов в формате stat_requests входного JSON, ответ - массив ответов на них;
+ *    - {"type": "ServerStats", "id": N} - счётчики сервера, ответ - словарь (см. WriteServerStats);
+ *    - {"type": "Reload", "id": N, "input": "<файл JSON>"} или {"type": "Reload", "id": N, "snapshot": "<файл снимка>"} -
+ *      новый справочник строится по base_requests файла JSON (CatalogueBuilder) или загружается из снимка и публикуется,
+ *      ответ {"request_id": N, "version": <номер снимка>} отправляется после публикации (см. Reload);
+ *    - при ошибке в строке ответ {"error_message": "..."}, соединение остаётся открытым;
+ *    - строка длиннее MAX_LINE_SIZE не разбирается: клиент получает {"error_message": "..."}, и соединение закрывается.
+ * 3) Каждое соединение обслуживает свой поток: пачки разных клиентов выполняются одновременно над общим снимком справочника
+ *    и общими SharedResources (маршрутизатор, кэш карт, пул потоков для больших пачек).
+ * 4) Справочник строится заново в потоке соединения, приславшего Reload: остальные соединения тем временем отвечают
+ *    по прежнему снимку, а пачки, начатые до публикации, дорабатывают на нём же. Перезагрузки выполняются по очереди,
+ *    при ошибке построения клиент получает {"error_message": "..."}, и остаётся прежний справочник.
+ * 5) Задержка пачки считается от получения строки до отправки ответа.
+ * Ошибки создания сокета выбрасываются как std::runtime_error.
+ */
+#include "catalogue_snapshot.h"
+#include "json.h"
+#include "map_renderer.h"
+#include "request_handler.h"
+#include "transport_router.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace transport {
+    namespace server {
+
+        class Server {
+        public:
+            Server(catalogue::CatalogueSnapshotHolder &catalogue, const map_renderer::RenderSettings &draw_settings,
+                   const transport_router::RouterSetting &router_settings);
+
+            /* Слушает address и обслуживает соединения, возвращает управление только исключением */
+            [[noreturn]] void Run(const std::string &address);
+
+        private:
+            /* Счётчики сервера, задержки в микросекундах */
+            struct Statistics {
+                std::atomic<uint64_t> connections{0};
+                std::atomic<uint64_t> batches{0};
+                std::atomic<uint64_t> requests{0};
+                std::atomic<uint64_t> errors{0};
+                std::atomic<uint64_t> lines{0}; // строки, на которые отправлен ответ: по ним считается средняя задержка
+                std::atomic<uint64_t> total_latency{0};
+                std::atomic<uint64_t> max_latency{0};
+            };
+
+            static constexpr size_t MAX_LINE_SIZE = 64 * 1024 * 1024;
+
+            static int Listen(const std::string &address);
+            void ServeConnection(int socket_fd);
+            /* Ответ на строку протокола без завершающего перевода строки */
+            std::string AnswerLine(std::string_view line);
+            /* Ответ {"error_message": message} без завершающего перевода строки */
+            std::string ErrorAnswer(std::string_view message) const;
+            /*
+             * Ответ на ServerStats: {"request_id", "uptime" (с), "connections", "batches", "requests", "errors",
+             * "requests_per_second" (за время работы), "average_latency" и "max_latency" (мс)}
+             */
+            void WriteServerStats(int id, json::Writer &writer) const;
+            /* Строит справочник по файлу из запроса Reload, публикует его и начинает строить для него маршрутизатор */
+            void Reload(const json::Dict &request, json::Writer &writer);
+            void AddLatency(uint64_t latency);
+
+            catalogue::CatalogueSnapshotHolder &catalogue_;
+            const map_renderer::RenderSettings &draw_settings_;
+            const transport_router::RouterSetting &router_settings_;
+            request_handler::SharedResources resources_;
+            const std::chrono::steady_clock::time_point start_time_;
+            Statistics stats_;
+            std::mutex reload_mutex_; // одна перезагрузка справочника за раз
+
+            const std::string str_type_ = "type";
+            const std::string str_id_ = "id";
+            const std::string str_server_stats_type_ = "ServerStats";
+            const std::string str_reload_type_ = "Reload";
+            const std::string str_input_ = "input";
+            const std::string str_snapshot_ = "snapshot";
+            const std::string str_version_ = "version";
+            const std::string str_request_id_ = "request_id";
+            const std::string str_error_ = "error_message";
+            const std::string str_uptime_ = "uptime";
+            const std::string str_connections_ = "connections";
+            const std::string str_batches_ = "batches";
+            const std::string str_requests_ = "requests";
+            const std::string str_errors_ = "errors";
+            const std::string str_requests_per_second_ = "requests_per_second";
+            const std::string str_average_latency_ = "average_latency";
+            const std::string str_max_latency_ = "max_latency";
+        };
+
+    } // namespace server
+} // namespace transport
@@ -0,0 +1,195 @@
+/* реализация k-d дерева над точками на поверхности Земли */
+#define _USE_MATH_DEFINES
+
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+
+namespace geo {
+
+    namespace {
+        constexpr size_t AXIS_COUNT = 3;
+        constexpr double BOX_TOLERANCE = 1e-12; // запас границ параллелепипеда на погрешность вычислений
+        const double DEG_TO_RAD = M_PI / 180.;
+
+        void ToUnitVector(Coordinates coords, double (&vec)[3]) {
+            const double lat = coords.lat * DEG_TO_RAD;
+            const double lng = coords.lng * DEG_TO_RAD;
+            vec[0] = std::cos(lat) * std::cos(lng);
+            vec[1] = std::cos(lat) * std::sin(lng);
+            vec[2] = std::sin(lat);
+        }
+
+        bool IsInBox(Coordinates coords, Coordinates min, Coordinates max) {
+            if (coords.lat < min.lat || coords.lat > max.lat) {
+                return false;
+            }
+            if (min.lng <= max.lng) {
+                return coords.lng >= min.lng && coords.lng <= max.lng;
+            }
+            return coords.lng >= min.lng || coords.lng <= max.lng; // прямоугольник пересекает 180-й меридиан
+        }
+
+        /* Диапазон значений функции func на отрезке долгот [from, to] (в градусах): значения на концах и в точках экстремума внутри отрезка */
+        template <typename Func>
+        std::pair<double, double> AngleFuncRange(double from, double to, Func func, std::initializer_list<double> extremum_points) {
+            double min_value = std::min(func(from * DEG_TO_RAD), func(to * DEG_TO_RAD));
+            double max_value = std::max(func(from * DEG_TO_RAD), func(to * DEG_TO_RAD));
+            for (double point : extremum_points) {
+                if (point >= from && point <= to) {
+                    min_value = std::min(min_value, func(point * DEG_TO_RAD));
+                    max_value = std::max(max_value, func(point * DEG_TO_RAD));
+                }
+            }
+            return {min_value, max_value};
+        }
+
+        /* Диапазон произведения a * b, где a в [a_range.first, a_range.second], b в [b_range.first, b_range.second] */
+        std::pair<double, double> ProductRange(std::pair<double, double> a_range, std::pair<double, double> b_range) {
+            const double products[] = {a_range.first * b_range.first, a_range.first * b_range.second,
+                                       a_range.second * b_range.first, a_range.second * b_range.second};
+            return {*std::min_element(std::begin(products), std::end(products)),
+                    *std::max_element(std::begin(products), std::end(products))};
+        }
+    } // namespace
+
+    SpatialIndex::SpatialIndex(const std::vector<IndexedPoint> &points) {
+        nodes_.reserve(points.size());
+        for (const IndexedPoint &point : points) {
+            Node node{{}, point.coords, point.id};
+            ToUnitVector(point.coords, node.axis);
+            nodes_.push_back(node);
+        }
+        Build(0, nodes_.size(), 0);
+        points_.Reserve(nodes_.size());
+        for (const Node &node : nodes_) {
+            points_.Add(node.coords);
+        }
+    }
+
+    void SpatialIndex::Build(size_t begin, size_t end, size_t depth) {
+        if (end - begin < 2) {
+            return;
+        }
+        const size_t mid = begin + (end - begin) / 2;
+        const size_t axis = depth % AXIS_COUNT;
+        std::nth_element(nodes_.begin() + static_cast<std::ptrdiff_t>(begin), nodes_.begin() + static_cast<std::ptrdiff_t>(mid),
+                         nodes_.begin() + static_cast<std::ptrdiff_t>(end),
+                         [axis](const Node &lhs, const Node &rhs) { return lhs.axis[axis] < rhs.axis[axis]; });
+        Build(begin, mid, depth + 1);
+        Build(mid + 1, end, depth + 1);
+    }
+
+    std::vector<size_t> SpatialIndex::FindNearestNodes(Coordinates center, size_t count) const {
+        std::vector<size_t> result;
+        if (count == 0 || nodes_.empty()) {
+            return result;
+        }
+        double center_vec[3];
+        ToUnitVector(center, center_vec);
+
+        std::vector<std::pair<double, size_t>> heap; // (квадрат длины хорды, индекс узла), наверху самая дальняя из найденных точек
+        heap.reserve(std::min(count, nodes_.size()) + 1);
+        SearchNearest(0, nodes_.size(), 0, center_vec, count, heap);
+        std::sort_heap(heap.begin(), heap.end());
+
+        result.reserve(heap.size());
+        for (const auto &[chord, node_idx] : heap) {
+            result.push_back(node_idx);
+        }
+        return result;
+    }
+
+    void SpatialIndex::SearchNearest(size_t begin, size_t end, size_t depth, const double (&center)[3], size_t count,
+                                     std::vector<std::pair<double, size_t>> &heap) const {
+        if (begin >= end) {
+            return;
+        }
+        const size_t mid = begin + (end - begin) / 2;
+        const Node &node = nodes_[mid];
+
+        double chord = 0;
+        for (size_t axis = 0; axis != AXIS_COUNT; ++axis) {
+            const double diff = center[axis] - node.axis[axis];
+            chord += diff * diff;
+        }
+        if (heap.size() < count) {
+            heap.emplace_back(chord, mid);
+            std::push_heap(heap.begin(), heap.end());
+        } else if (chord < heap.front().first) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = {chord, mid};
+            std::push_heap(heap.begin(), heap.end());
+        }
+
+        const size_t axis = depth % AXIS_COUNT;
+        const double plane_diff = center[axis] - node.axis[axis];
+        const bool left_first = plane_diff < 0;
+        if (left_first) {
+            SearchNearest(begin, mid, depth + 1, center, count, heap);
+        } else {
+            SearchNearest(mid + 1, end, depth + 1, center, count, heap);
+        }
+        // вторую половину смотрим, только если плоскость разбиения ближе самой дальней из найденных точек
+        if (heap.size() < count || plane_diff * plane_diff < heap.front().first) {
+            if (left_first) {
+                SearchNearest(mid + 1, end, depth + 1, center, count, heap);
+            } else {
+                SearchNearest(begin, mid, depth + 1, center, count, heap);
+            }
+        }
+    }
+
+    /*
+     * Прямоугольник широт и долгот переводится в описанный вокруг него параллелепипед в пространстве единичных векторов:
+     * x = cos(lat) * cos(lng), y = cos(lat) * sin(lng), z = sin(lat). Параллелепипед используется только для отсечения ветвей дерева,
+     * каждая точка внутри него проверяется по широте и долготе.
+     */
+    std::vector<size_t> SpatialIndex::FindInBox(Coordinates min, Coordinates max) const {
+        std::vector<size_t> result;
+        if (nodes_.empty() || min.lat > max.lat) {
+            return result;
+        }
+        auto cos_func = [](double angle) { return std::cos(angle); };
+        auto sin_func = [](double angle) { return std::sin(angle); };
+
+        const std::pair<double, double> lat_cos = AngleFuncRange(min.lat, max.lat, cos_func, {0.});
+        std::pair<double, double> lng_cos{-1., 1.};
+        std::pair<double, double> lng_sin{-1., 1.};
+        if (min.lng <= max.lng) {
+            lng_cos = AngleFuncRange(min.lng, max.lng, cos_func, {0., -180., 180.});
+            lng_sin = AngleFuncRange(min.lng, max.lng, sin_func, {-90., 90.});
+        }
+        const std::pair<double, double> x_range = ProductRange(lat_cos, lng_cos);
+        const std::pair<double, double> y_range = ProductRange(lat_cos, lng_sin);
+
+        Box3d box{{x_range.first - BOX_TOLERANCE, y_range.first - BOX_TOLERANCE, std::sin(min.lat * DEG_TO_RAD) - BOX_TOLERANCE},
+                  {x_range.second + BOX_TOLERANCE, y_range.second + BOX_TOLERANCE, std::sin(max.lat * DEG_TO_RAD) + BOX_TOLERANCE}};
+        SearchBox(0, nodes_.size(), 0, box, min, max, result);
+        return result;
+    }
+
+    void SpatialIndex::SearchBox(size_t begin, size_t end, size_t depth, const Box3d &box, Coordinates min, Coordinates max,
+                                 std::vector<size_t> &result) const {
+        if (begin >= end) {
+            return;
+        }
+        const size_t mid = begin + (end - begin) / 2;
+        const Node &node = nodes_[mid];
+        if (IsInBox(node.coords, min, max)) {
+            result.push_back(node.id);
+        }
+        const size_t axis = depth % AXIS_COUNT;
+        if (box.min[axis] <= node.axis[axis]) {
+            SearchBox(begin, mid, depth + 1, box, min, max, result);
+        }
+        if (box.max[axis] >= node.axis[axis]) {
+            SearchBox(mid + 1, end, depth + 1, box, min, max, result);
+        }
+    }
+
+} // namespace geo
@@ -0,0 +1,90 @@
+#pragma once
+/*
+ * Статический пространственный индекс точек на поверхности Земли (k-d дерево).
+ * 1) Точки задаются географическими координатами и номером (id), индекс строится один раз и больше не изменяется.
+ * 2) Внутри индекса точки переводятся в единичные векторы трёхмерного пространства (x, y, z). Длина хорды между такими векторами
+ * монотонно связана с расстоянием по дуге большого круга, поэтому ближайшие по хорде точки являются ближайшими и на сфере,
+ * а для отсечения ветвей дерева достаточно сравнения координат по одной оси. Переход через 180-й меридиан не требует особой обработки.
+ * 3) Дерево неявное: точки хранятся в одном векторе, корень поддерева [begin, end) лежит в середине диапазона,
+ * ось разбиения выбирается по глубине (x, y, z по кругу). Дополнительной памяти на узлы не требуется.
+ *
+ * Запросы:
+ * - FindNearest<Mode>(center, count) - не более count ближайших к center точек, отсортированных по возрастанию расстояния (в метрах).
+ *   Порядок точек не зависит от Mode (ближайшие ищутся по длине хорды), Mode задаёт только способ расчёта выдаваемых расстояний;
+ *   для DistanceMode::EXACT расстояния считаются одним пакетом (geo::ComputeDistances);
+ * - FindInBox(min, max) - номера всех точек, у которых широта в [min.lat, max.lat] и долгота в [min.lng, max.lng].
+ */
+
+#include "geo.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace geo {
+
+    struct IndexedPoint {
+        Coordinates coords;
+        size_t id = 0;
+    };
+
+    struct NearPoint {
+        size_t id = 0;
+        double distance = 0;
+    };
+
+    class SpatialIndex {
+    public:
+        SpatialIndex() = default;
+        explicit SpatialIndex(const std::vector<IndexedPoint> &points);
+
+        template <DistanceMode Mode = DistanceMode::EXACT>
+        std::vector<NearPoint> FindNearest(Coordinates center, size_t count) const {
+            const std::vector<size_t> node_indices = FindNearestNodes(center, count);
+            std::vector<double> distances(node_indices.size());
+            if constexpr (Mode == DistanceMode::EXACT) {
+                ComputeDistances(center, points_, node_indices.data(), node_indices.size(), distances.data());
+            } else {
+                for (size_t k = 0; k != node_indices.size(); ++k) {
+                    distances[k] = ComputeDistance<Mode>(center, nodes_[node_indices[k]].coords);
+                }
+            }
+
+            std::vector<NearPoint> result;
+            result.reserve(node_indices.size());
+            for (size_t k = 0; k != node_indices.size(); ++k) {
+                result.push_back({nodes_[node_indices[k]].id, distances[k]});
+            }
+            return result;
+        }
+
+        std::vector<size_t> FindInBox(Coordinates min, Coordinates max) const;
+
+        size_t GetSize() const {
+            return nodes_.size();
+        }
+
+    private:
+        struct Node {
+            double axis[3]; // координаты единичного вектора x, y, z
+            Coordinates coords;
+            size_t id;
+        };
+
+        struct Box3d {
+            double min[3];
+            double max[3];
+        };
+
+        void Build(size_t begin, size_t end, size_t depth);
+        /* Номера узлов с ближайшими к center точками по возрастанию расстояния */
+        std::vector<size_t> FindNearestNodes(Coordinates center, size_t count) const;
+        void SearchNearest(size_t begin, size_t end, size_t depth, const double (&center)[3], size_t count,
+                           std::vector<std::pair<double, size_t>> &heap) const;
+        void SearchBox(size_t begin, size_t end, size_t depth, const Box3d &box, Coordinates min, Coordinates max,
+                       std::vector<size_t> &result) const;
+
+        std::vector<Node> nodes_;
+        PointArray points_; // координаты узлов в том же порядке, что и nodes_, для пакетного расчёта расстояний
+    };
+
+} // namespace geo
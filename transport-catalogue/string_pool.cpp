@@ -0,0 +1,53 @@
+/* реализация пула строк */
+#include "string_pool.h"
+
+#include <cstring>
+#include <functional>
+
+namespace transport {
+    namespace catalogue {
+
+        std::string_view StringPool::Add(std::string_view str) {
+            // пустой строке память не нужна, а Allocate(0) до первого блока обратился бы к несуществующему блоку
+            if (str.empty()) {
+                return {};
+            }
+            if (IsAdopted(str)) {
+                return str;
+            }
+            char *data = Allocate(str.size());
+            std::memcpy(data, str.data(), str.size());
+            return {data, str.size()};
+        }
+
+        void StringPool::Adopt(std::shared_ptr<const void> owner, std::string_view region) {
+            adopted_owners_.push_back(std::move(owner));
+            adopted_regions_.push_back(region);
+        }
+
+        bool StringPool::IsAdopted(std::string_view str) const {
+            const std::less<const char *> less;
+            for (std::string_view region : adopted_regions_) {
+                if (!less(str.data(), region.data()) && !less(region.data() + region.size(), str.data() + str.size())) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /* Строки длиннее блока получают собственный блок, остальные дописываются в последний блок */
+        char *StringPool::Allocate(size_t size) {
+            if (size > block_size_) {
+                return large_blocks_.emplace_back(std::make_unique<char[]>(size)).get();
+            }
+            if (block_used_ + size > block_size_) {
+                blocks_.push_back(std::make_unique<char[]>(block_size_));
+                block_used_ = 0;
+            }
+            char *result = blocks_.back().get() + block_used_;
+            block_used_ += size;
+            return result;
+        }
+
+    } // namespace catalogue
+} // namespace transport
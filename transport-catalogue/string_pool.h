@@ -0,0 +1,49 @@
+#pragma once
+/*
+ * Пул строк (арена) для имён остановок и маршрутов.
+ * 1) Add копирует строку в пул без поиска дубликатов: уникальность обеспечивает вызывающий код
+ * (например, справочник хранит имена остановок в словаре stop_names_ и сам не добавляет одно имя дважды).
+ * 2) Строки складываются подряд в крупные блоки памяти, поэтому нет отдельной аллокации на каждое имя.
+ * 3) Возвращаемые std::string_view действительны, пока жив пул. Блоки не перемещаются при росте пула.
+ * 4) Вся память пула освобождается разом при разрушении пула.
+ * 5) Пул может принять во владение внешнюю память, в которой строки уже лежат подряд (Adopt), например, отображённый в память
+ * файл снимка справочника. Строки из такой памяти Add не копирует, а возвращает как есть.
+ */
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace transport {
+    namespace catalogue {
+
+        class StringPool {
+        public:
+            StringPool() = default;
+            StringPool(const StringPool &) = delete;
+            StringPool &operator=(const StringPool &) = delete;
+            StringPool(StringPool &&) = default;
+            StringPool &operator=(StringPool &&) = default;
+
+            /* Копирует str в пул без проверки на дубликаты */
+            std::string_view Add(std::string_view str);
+
+            /* Удерживает owner, пока жив пул. Строки, лежащие внутри region, больше не копируются в пул */
+            void Adopt(std::shared_ptr<const void> owner, std::string_view region);
+
+        private:
+            char *Allocate(size_t size);
+            bool IsAdopted(std::string_view str) const;
+
+            static constexpr size_t block_size_ = 64 * 1024;
+
+            std::vector<std::unique_ptr<char[]>> blocks_;
+            std::vector<std::unique_ptr<char[]>> large_blocks_; // блоки под строки длиннее block_size_
+            size_t block_used_ = block_size_; // занято в последнем блоке; изначально блоков нет - "последний блок заполнен"
+            std::vector<std::shared_ptr<const void>> adopted_owners_;
+            std::vector<std::string_view> adopted_regions_;
+        };
+
+    } // namespace catalogue
+} // namespace transport
@@ -74,6 +74,27 @@ namespace svg {
 
     using namespace std::literals;
 
+    bool Rgb::operator==(const Rgb &other) const {
+        return red == other.red && green == other.green && blue == other.blue;
+    }
+    bool Rgb::operator!=(const Rgb &other) const {
+        return !(*this == other);
+    }
+
+    bool Rgba::operator==(const Rgba &other) const {
+        return red == other.red && green == other.green && blue == other.blue && opacity == other.opacity;
+    }
+    bool Rgba::operator!=(const Rgba &other) const {
+        return !(*this == other);
+    }
+
+    bool Point::operator==(const Point &other) const {
+        return x == other.x && y == other.y;
+    }
+    bool Point::operator!=(const Point &other) const {
+        return !(*this == other);
+    }
+
     void Object::Render(const RenderContext &context) const {
         context.RenderIndent();
 
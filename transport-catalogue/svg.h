@@ -13,6 +13,8 @@ namespace svg {
     struct Rgb {
         Rgb() = default;
         Rgb(uint8_t r, uint8_t g, uint8_t b) : red(r), green(g), blue(b) {}
+        bool operator==(const Rgb &other) const;
+        bool operator!=(const Rgb &other) const;
         uint8_t red = 0;
         uint8_t green = 0;
         uint8_t blue = 0;
@@ -21,6 +23,8 @@ namespace svg {
     struct Rgba {
         Rgba() = default;
         Rgba(uint8_t r, uint8_t g, uint8_t b, double o) : red(r), green(g), blue(b), opacity(o) {}
+        bool operator==(const Rgba &other) const;
+        bool operator!=(const Rgba &other) const;
         uint8_t red = 0;
         uint8_t green = 0;
         uint8_t blue = 0;
@@ -62,6 +66,8 @@ namespace svg {
         Point(double coord_x, double coord_y)
             : x(coord_x), y(coord_y) {
         }
+        bool operator==(const Point &other) const;
+        bool operator!=(const Point &other) const;
 
         double x = 0;
         double y = 0;
@@ -0,0 +1,145 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace transport {
+    namespace request_handler {
+
+        WorkStealingPool::WorkStealingPool(size_t threads_num) {
+            threads_num = std::max<size_t>(1, threads_num);
+            for (size_t i = 0; i != threads_num; ++i) {
+                ranges_.push_back(std::make_unique<TaskRange>());
+            }
+            threads_.reserve(threads_num - 1);
+            for (size_t worker_idx = 1; worker_idx != threads_num; ++worker_idx) {
+                threads_.emplace_back(&WorkStealingPool::WorkerLoop, this, worker_idx);
+            }
+        }
+
+        WorkStealingPool::~WorkStealingPool() {
+            {
+                std::lock_guard lock(mutex_);
+                stop_ = true;
+            }
+            start_cv_.notify_all();
+            for (std::thread &thread : threads_) {
+                thread.join();
+            }
+        }
+
+        void WorkStealingPool::ParallelFor(size_t task_count, const Task &task) {
+            if (task_count == 0) {
+                return;
+            }
+            std::lock_guard run_lock(run_mutex_);
+
+            const size_t workers_num = ranges_.size();
+            const size_t chunk_size = (task_count + workers_num - 1) / workers_num;
+            for (size_t worker_idx = 0; worker_idx != workers_num; ++worker_idx) {
+                TaskRange &range = *ranges_[worker_idx];
+                std::lock_guard range_lock(range.mutex);
+                range.begin = std::min(worker_idx * chunk_size, task_count);
+                range.end = std::min(range.begin + chunk_size, task_count);
+            }
+            {
+                std::lock_guard lock(mutex_);
+                task_ = &task;
+                error_ = nullptr;
+                running_ = threads_.size();
+                ++generation_;
+            }
+            start_cv_.notify_all();
+
+            RunTasks(0);
+
+            std::unique_lock lock(mutex_);
+            done_cv_.wait(lock, [this] {
+                return running_ == 0;
+            });
+            task_ = nullptr;
+            if (error_) {
+                std::rethrow_exception(std::exchange(error_, nullptr));
+            }
+        }
+
+        void WorkStealingPool::WorkerLoop(size_t worker_idx) {
+            uint64_t done_generation = 0;
+            while (true) {
+                {
+                    std::unique_lock lock(mutex_);
+                    start_cv_.wait(lock, [this, done_generation] {
+                        return stop_ || generation_ != done_generation;
+                    });
+                    if (stop_) {
+                        return;
+                    }
+                    done_generation = generation_;
+                }
+                RunTasks(worker_idx);
+                {
+                    std::lock_guard lock(mutex_);
+                    --running_;
+                }
+                done_cv_.notify_one();
+            }
+        }
+
+        void WorkStealingPool::RunTasks(size_t worker_idx) {
+            size_t task_idx = 0;
+            while (true) {
+                if (!PopTask(worker_idx, task_idx)) {
+                    if (!StealTasks(worker_idx)) {
+                        return;
+                    }
+                    continue;
+                }
+                try {
+                    (*task_)(worker_idx, task_idx);
+                } catch (...) {
+                    std::lock_guard lock(mutex_);
+                    if (!error_) {
+                        error_ = std::current_exception();
+                    }
+                }
+            }
+        }
+
+        bool WorkStealingPool::PopTask(size_t worker_idx, size_t &task_idx) {
+            TaskRange &range = *ranges_[worker_idx];
+            std::lock_guard lock(range.mutex);
+            if (range.begin == range.end) {
+                return false;
+            }
+            task_idx = range.begin++;
+            return true;
+        }
+
+        bool WorkStealingPool::StealTasks(size_t worker_idx) {
+            const size_t workers_num = ranges_.size();
+            for (size_t offset = 1; offset != workers_num; ++offset) {
+                TaskRange &victim = *ranges_[(worker_idx + offset) % workers_num];
+                size_t begin = 0;
+                size_t end = 0;
+                {
+                    std::lock_guard lock(victim.mutex);
+                    const size_t remaining = victim.end - victim.begin;
+                    if (remaining == 0) {
+                        continue;
+                    }
+                    // у владельца остаётся начало диапазона, которое он и так возьмёт следующим
+                    end = victim.end;
+                    begin = end - (remaining + 1) / 2;
+                    victim.end = begin;
+                }
+                TaskRange &own = *ranges_[worker_idx];
+                std::lock_guard lock(own.mutex);
+                own.begin = begin;
+                own.end = end;
+                return true;
+            }
+            return false;
+        }
+
+    } // namespace request_handler
+} // namespace transport
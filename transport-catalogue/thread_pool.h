@@ -0,0 +1,73 @@
+#pragma once
+/*
+ * Пул потоков с перехватом работы (work stealing) для параллельного выполнения независимых задач.
+ * 1) Потоки создаются один раз в конструкторе и ждут работы, так что пул можно использовать для многих пачек задач подряд.
+ * 2) ParallelFor(task_count, task) выполняет task(worker_idx, task_idx) для каждого task_idx из [0, task_count) и возвращается,
+ * когда выполнены все задачи. Исполнитель 0 - вызывающий поток, поэтому пул из одного потока не создаёт потоков вовсе.
+ * worker_idx позволяет задаче писать в данные своего исполнителя без блокировок (например, в свой буфер вывода).
+ * 3) Задачи делятся на равные непрерывные диапазоны по числу исполнителей. Исполнитель берёт задачи с начала своего диапазона,
+ * а когда тот кончился - забирает вторую половину оставшегося диапазона у другого исполнителя. Так неравные по стоимости задачи
+ * не оставляют потоки без работы, а соседние задачи в основном выполняются одним потоком.
+ * 4) Если задача выбросила исключение, остальные задачи всё равно выполняются, а первое исключение ParallelFor выбрасывает
+ * после их завершения. Одновременные вызовы ParallelFor из разных потоков выполняются по очереди.
+ */
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace transport {
+    namespace request_handler {
+
+        class WorkStealingPool {
+        public:
+            /* Задача получает номер исполнителя и номер задачи */
+            using Task = std::function<void(size_t worker_idx, size_t task_idx)>;
+
+            explicit WorkStealingPool(size_t threads_num);
+            WorkStealingPool(const WorkStealingPool &) = delete;
+            WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+            ~WorkStealingPool();
+
+            /* Количество исполнителей, включая вызывающий поток */
+            size_t GetThreadCount() const {
+                return ranges_.size();
+            }
+
+            void ParallelFor(size_t task_count, const Task &task);
+
+        private:
+            /* Ещё не взятые задачи исполнителя [begin, end) */
+            struct TaskRange {
+                std::mutex mutex;
+                size_t begin = 0;
+                size_t end = 0;
+            };
+
+            void WorkerLoop(size_t worker_idx);
+            void RunTasks(size_t worker_idx);
+            bool PopTask(size_t worker_idx, size_t &task_idx);
+            /* Забирает половину задач другого исполнителя в свой диапазон, false - задач не осталось ни у кого */
+            bool StealTasks(size_t worker_idx);
+
+            std::vector<std::unique_ptr<TaskRange>> ranges_;
+            std::vector<std::thread> threads_;
+
+            std::mutex run_mutex_; // один ParallelFor за раз
+            std::mutex mutex_;
+            std::condition_variable start_cv_;
+            std::condition_variable done_cv_;
+            const Task *task_ = nullptr;
+            uint64_t generation_ = 0; // номер текущего ParallelFor: по его смене потоки начинают работу
+            size_t running_ = 0;      // потоки пула, ещё не закончившие текущий ParallelFor
+            bool stop_ = false;
+            std::exception_ptr error_;
+        };
+
+    } // namespace request_handler
+} // namespace transport
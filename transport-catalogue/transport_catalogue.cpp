@@ -3,21 +3,28 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <iostream>
 #include <iterator>
+#include <thread>
 #include <utility>
 
 namespace transport {
     namespace catalogue {
 
+        namespace {
+            std::atomic<uint64_t> last_catalogue_version{0};
+        } // namespace
+
         void TransportCatalogue::AddStop(std::string_view stop_name, geo::Coordinates location) {
-            stops_.push_back({location, std::string(stop_name)});
+            stops_.push_back({location, names_.Add(stop_name), stops_.size()});
             stop_names_[stops_.back().name] = &stops_.back();
+            buses_for_stop_.emplace_back();
         }
 
         void TransportCatalogue::AddStopDistances(std::string_view stop_name_from, std::string_view stop_name_to, size_t distance) {
-            Stop *stop_from = nullptr;
-            Stop *stop_to = nullptr;
+            const Stop *stop_from = nullptr;
+            const Stop *stop_to = nullptr;
             if (stop_names_.count(stop_name_from) > 0) {
                 stop_from = stop_names_[stop_name_from];
             } else {
@@ -32,122 +39,224 @@ namespace transport {
             stops_dist_[{stop_from, stop_to}] = distance;
         }
 
-        void TransportCatalogue::AddBus(std::string_view bus_name, const std::vector<std::string_view> &stops, bool is_roundtrip) {
+        void TransportCatalogue::AddBus(std::string_view bus_name, const std::vector<std::string_view> &stops, bool is_roundtrip,
+                                        const std::optional<BusStatistics> &bus_stat) {
             Bus bus;
-            bus.bus_stat = {};
-            bus.name = std::string(bus_name);
+            bus.bus_stat = bus_stat.value_or(BusStatistics{});
+            precomputed_bus_stat_.push_back(bus_stat.has_value());
+            bus.name = names_.Add(bus_name);
+            bus.id = buses_.size();
             bus.is_roundtrip_ = is_roundtrip;
+            bus.stops.reserve(stops.size());
             for (auto stop : stops) {
-                buses_for_stop_[FindStop(stop)->name].insert(bus.name);
-                Stop *cur_stop = stop_names_.at(stop);
+                const Stop *cur_stop = stop_names_.at(stop);
+                buses_for_stop_[cur_stop->id].push_back(bus.name);
                 bus.stops.push_back(cur_stop);
             }
             buses_.push_back(std::move(bus));
             bus_names_[buses_.back().name] = &buses_.back();
         }
 
-        Stop *TransportCatalogue::FindStop(const std::string_view stop_name) const {
+        const Stop *TransportCatalogue::FindStop(const std::string_view stop_name) const {
             if (stop_names_.count(stop_name) > 0) {
                 return stop_names_.at(stop_name);
             }
             return nullptr;
         }
 
-        Bus *TransportCatalogue::FindBus(const std::string_view bus_name) const {
+        const Bus *TransportCatalogue::FindBus(const std::string_view bus_name) const {
             if (bus_names_.count(bus_name) > 0) {
                 return bus_names_.at(bus_name);
             }
             return nullptr;
         }
 
-        std::optional<BusStatistics> TransportCatalogue::GetBusStatistics(const std::string_view bus_name) const {
-            Bus *bus = FindBus(bus_name);
-            if (bus != nullptr) {
-                if (bus->bus_stat.length == 0) {
-                    const auto res = CalculateTotalDistance(bus);
-                    bus->bus_stat.length = res.geographic;
-                    bus->bus_stat.distance = res.measured;
-                    bus->bus_stat.curvature = static_cast<double>(bus->bus_stat.distance) / bus->bus_stat.length;
-                    bus->bus_stat.stops_num = bus->stops.size();
-
-                    std::unordered_set<std::string> unique_stops;
-                    for (const Stop *stop : bus->stops) {
-                        unique_stops.insert(stop->name);
+        /*
+         * Статистика маршрутов рассчитывается один раз для всех автобусов: маршруты делятся на равные части,
+         * каждую часть обрабатывает свой поток. Потоки пишут только в bus_stat и bus_segments_ своих маршрутов, остальные данные только читают.
+         * Префиксные суммы длин строятся и для маршрутов с готовой статистикой - по ним считаются длины участков маршрута.
+         */
+        void TransportCatalogue::Finalize() {
+            const size_t bus_count = buses_.size();
+            const size_t hardware_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+            const size_t threads_num = std::min(hardware_threads, (bus_count + min_buses_per_thread_ - 1) / min_buses_per_thread_);
+
+            geo::PointArray stop_points;
+            stop_points.Reserve(stops_.size());
+            for (const Stop &stop : stops_) {
+                stop_points.Add(stop.location);
+            }
+
+            bus_segments_.resize(bus_count);
+            auto calculate_range = [this, &stop_points](size_t begin_idx, size_t end_idx) {
+                for (size_t idx = begin_idx; idx != end_idx; ++idx) {
+                    bus_segments_[idx] = CalculateBusSegments(&buses_[idx], stop_points);
+                    if (!precomputed_bus_stat_[idx]) {
+                        buses_[idx].bus_stat = CalculateBusStatistics(&buses_[idx]);
                     }
-                    bus->bus_stat.uniq_stops_num = unique_stops.size();
                 }
+            };
+
+            if (threads_num <= 1) {
+                calculate_range(0, bus_count);
+            } else {
+                std::vector<std::thread> workers;
+                workers.reserve(threads_num - 1);
+                const size_t chunk_size = (bus_count + threads_num - 1) / threads_num;
+                for (size_t begin_idx = chunk_size; begin_idx < bus_count; begin_idx += chunk_size) {
+                    workers.emplace_back(calculate_range, begin_idx, std::min(begin_idx + chunk_size, bus_count));
+                }
+                calculate_range(0, std::min(chunk_size, bus_count));
+                for (std::thread &worker : workers) {
+                    worker.join();
+                }
+            }
+            /* Список маршрутов остановки: сортировка и удаление повторов (маршрут может проходить через остановку несколько раз) */
+            for (std::vector<std::string_view> &buses : buses_for_stop_) {
+                std::sort(buses.begin(), buses.end());
+                buses.erase(std::unique(buses.begin(), buses.end()), buses.end());
+                buses.shrink_to_fit();
+            }
+
+            std::vector<geo::IndexedPoint> indexed_stops;
+            indexed_stops.reserve(stops_.size());
+            for (const Stop &stop : stops_) {
+                indexed_stops.push_back({stop.location, stop.id});
+            }
+            stops_index_ = geo::SpatialIndex(indexed_stops);
+            stops_by_name_ = NameIndex<Stop>(stops_);
+            buses_by_name_ = NameIndex<Bus>(buses_);
+            served_stops_.clear();
+            for (const Stop *stop : stops_by_name_.GetAll()) {
+                if (!buses_for_stop_[stop->id].empty()) {
+                    served_stops_.push_back(stop);
+                }
+            }
+            served_stops_.shrink_to_fit();
+            is_finalized_ = true;
+        }
+
+        std::optional<BusStatistics> TransportCatalogue::GetBusStatistics(const std::string_view bus_name) const {
+            assert(is_finalized_);
+            const Bus *bus = FindBus(bus_name);
+            if (bus != nullptr) {
                 return bus->bus_stat;
             }
             return std::nullopt;
         }
 
-        DistanceBetweenStops TransportCatalogue::CalculateTotalDistance(const Bus *bus) const {
-            using namespace geo;
+        /* Количество уникальных остановок считается сортировкой указателей на остановки, без копирования имён */
+        BusStatistics TransportCatalogue::CalculateBusStatistics(const Bus *bus) const {
+            BusStatistics bus_stat;
+            if (bus->stops.empty()) {
+                return bus_stat;
+            }
+            const BusSegments &segments = bus_segments_[bus->id];
+            bus_stat.length = segments.geographic.back();
+            bus_stat.distance = segments.measured.back();
+            if (bus_stat.length > 0) {
+                bus_stat.curvature = static_cast<double>(bus_stat.distance) / bus_stat.length;
+            }
+            bus_stat.stops_num = bus->GetRouteStopCount();
 
-            double length = 0;
-            size_t distance = 0;
+            std::vector<const Stop *> unique_stops(bus->stops); // обратный ход некольцевого маршрута новых остановок не добавляет
+            std::sort(unique_stops.begin(), unique_stops.end());
+            bus_stat.uniq_stops_num = static_cast<size_t>(std::distance(unique_stops.begin(),
+                                                                        std::unique(unique_stops.begin(), unique_stops.end())));
+            return bus_stat;
+        }
 
-            Coordinates geo_from_stop, geo_to_stop;
-            geo_from_stop = {bus->stops.front()->location.lat, bus->stops.front()->location.lng};
+        /* Географические длины перегонов считаются одним пакетом по всему маршруту (geo::ComputePathDistances) */
+        BusSegments TransportCatalogue::CalculateBusSegments(const Bus *bus, const geo::PointArray &stop_points) const {
+            BusSegments segments;
+            const size_t route_stop_count = bus->GetRouteStopCount();
+            if (route_stop_count == 0) {
+                return segments;
+            }
+            std::vector<size_t> route_stop_ids;
+            route_stop_ids.reserve(route_stop_count);
+            for (const Stop *stop : bus->GetRouteStops()) {
+                route_stop_ids.push_back(stop->id);
+            }
+            std::vector<double> geo_lengths(route_stop_count - 1);
+            geo::ComputePathDistances(stop_points, route_stop_ids.data(), route_stop_count, geo_lengths.data());
 
-            Stop *stop_from, *stop_to;
-            stop_from = bus->stops[0];
+            segments.geographic.reserve(route_stop_count);
+            segments.measured.reserve(route_stop_count);
+            double length = 0;
+            size_t distance = 0;
+            segments.geographic.push_back(length);
+            segments.measured.push_back(distance);
 
-            for (size_t idx = 1; idx != bus->stops.size(); ++idx) {
-                stop_to = bus->stops[idx];
+            for (size_t pos = 1; pos != route_stop_count; ++pos) {
+                const Stop *stop_from = &stops_[route_stop_ids[pos - 1]];
+                const Stop *stop_to = &stops_[route_stop_ids[pos]];
                 if (stops_dist_.count({stop_from, stop_to}) > 0) {
                     distance += stops_dist_.at({stop_from, stop_to});
                 } else if (stops_dist_.count({stop_to, stop_from}) > 0) {
                     distance += stops_dist_.at({stop_to, stop_from});
                 }
-
-                geo_to_stop = {stop_to->location.lat, stop_to->location.lng};
-                length += ComputeDistance(geo_from_stop, geo_to_stop);
-                geo_from_stop = geo_to_stop;
-
-                stop_from = stop_to;
+                length += geo_lengths[pos - 1];
+                segments.geographic.push_back(length);
+                segments.measured.push_back(distance);
             }
-            return {length, distance};
+            return segments;
         }
 
-        std::optional<std::vector<std::string>> TransportCatalogue::GetStopStatistics(const std::string_view stop_name) const {
-            std::vector<std::string> buses;
-            if (FindStop(stop_name) != nullptr) {
-                if (buses_for_stop_.count(stop_name) > 0) {
-                    for (std::string_view bus : buses_for_stop_.at(stop_name)) {
-                        buses.push_back(std::string(bus));
-                    }
-                    std::sort(buses.begin(), buses.end());
-                }
-                return buses;
+        DistanceBetweenStops TransportCatalogue::GetSegmentDistance(const Bus *bus, size_t from_pos, size_t to_pos) const {
+            assert(is_finalized_);
+            assert(from_pos <= to_pos && to_pos < bus->GetRouteStopCount());
+            const BusSegments &segments = bus_segments_[bus->id];
+            return {segments.geographic[to_pos] - segments.geographic[from_pos], segments.measured[to_pos] - segments.measured[from_pos]};
+        }
+
+        std::optional<std::vector<std::string_view>> TransportCatalogue::GetStopStatistics(const std::string_view stop_name) const {
+            const Stop *stop = FindStop(stop_name);
+            if (stop != nullptr) {
+                return buses_for_stop_[stop->id];
             }
             return std::nullopt;
         }
 
-        /* Перебираем все остановки и наполняем вектор имён всех остановок с маршрутами */
-        std::vector<std::string> TransportCatalogue::GetAllStopNames() const {
-            std::vector<std::string> all_stop_names;
-            all_stop_names.reserve(stops_.size());
-            for(const Stop& stop : stops_) {
-                if (buses_for_stop_.count(stop.name) && !buses_for_stop_.at(stop.name).empty()) {
-                    all_stop_names.emplace_back(stop.name);
-                }
+        bool TransportCatalogue::IsStopServed(const Stop *stop) const {
+            return !buses_for_stop_[stop->id].empty();
+        }
+
+        std::vector<NearStop> TransportCatalogue::NearestStops(geo::Coordinates point, size_t count) const {
+            std::vector<NearStop> result;
+            for (const geo::NearPoint &near_point : stops_index_.FindNearest(point, count)) {
+                result.push_back({&stops_[near_point.id], near_point.distance});
             }
-            return all_stop_names;
+            return result;
         }
 
-        /* Перебираем все маршруты и наполняем вектор имён всех маршрутов */
-        std::vector<std::string> TransportCatalogue::GetAllBusNames() const {
-            std::vector<std::string> all_bus_names;
-            all_bus_names.reserve(buses_.size());
-            for(const Bus &bus : buses_) {
-                all_bus_names.emplace_back(bus.name);
+        std::vector<const Stop *> TransportCatalogue::StopsInBox(geo::Coordinates min, geo::Coordinates max) const {
+            std::vector<const Stop *> result;
+            for (size_t stop_id : stops_index_.FindInBox(min, max)) {
+                result.push_back(&stops_[stop_id]);
             }
-            return all_bus_names;
+            std::sort(result.begin(), result.end(), [](const Stop *lhs, const Stop *rhs) { return lhs->name < rhs->name; });
+            return result;
+        }
+
+        ranges::Range<NameIndex<Stop>::Iterator> TransportCatalogue::FindStopsByPrefix(std::string_view prefix, size_t count) const {
+            return stops_by_name_.FindByPrefix(prefix, count);
+        }
+
+        ranges::Range<NameIndex<Bus>::Iterator> TransportCatalogue::FindBusesByPrefix(std::string_view prefix, size_t count) const {
+            return buses_by_name_.FindByPrefix(prefix, count);
+        }
+
+        ranges::Range<NameIndex<Stop>::Iterator> TransportCatalogue::GetServedStopsByName() const {
+            return ranges::AsRange(served_stops_);
+        }
+
+        ranges::Range<NameIndex<Bus>::Iterator> TransportCatalogue::GetBusesByName() const {
+            return buses_by_name_.GetAll();
         }
 
         /* Расстояние между остановками исключительно рядом стоящими */
-        size_t TransportCatalogue::GetDistanceBetwenStops(Stop *stop_from, Stop *stop_to) const {
+        size_t TransportCatalogue::GetDistanceBetwenStops(const Stop *stop_from, const Stop *stop_to) const {
             if (stops_dist_.count({stop_from, stop_to}) > 0) {
                 return stops_dist_.at({stop_from, stop_to});
             }
@@ -157,5 +266,52 @@ namespace transport {
         size_t TransportCatalogue::GetStopCount() const {
             return stops_.size();
         }
+
+        uint64_t TransportCatalogue::GetVersion() const {
+            return version_;
+        }
+
+        ranges::Range<std::deque<Stop>::const_iterator> TransportCatalogue::GetStops() const {
+            return ranges::AsRange(stops_);
+        }
+
+        ranges::Range<std::deque<Bus>::const_iterator> TransportCatalogue::GetBuses() const {
+            return ranges::AsRange(buses_);
+        }
+
+        ranges::Range<TransportCatalogue::StopsDistanceMap::const_iterator> TransportCatalogue::GetStopDistances() const {
+            return ranges::AsRange(stops_dist_);
+        }
+
+        /* ------------------------------- CatalogueBuilder ------------------------------- */
+
+        CatalogueBuilder::CatalogueBuilder()
+            : catalogue_(std::make_unique<TransportCatalogue>()) {
+        }
+
+        void CatalogueBuilder::AddStop(std::string_view stop_name, geo::Coordinates location) {
+            catalogue_->AddStop(stop_name, location);
+        }
+
+        void CatalogueBuilder::AddStopDistances(std::string_view stop_name_from, std::string_view stop_name_to, size_t dist) {
+            catalogue_->AddStopDistances(stop_name_from, stop_name_to, dist);
+        }
+
+        void CatalogueBuilder::AddBus(std::string_view bus_name, const std::vector<std::string_view> &stops, bool is_roundtrip,
+                                      const std::optional<BusStatistics> &bus_stat) {
+            catalogue_->AddBus(bus_name, stops, is_roundtrip, bus_stat);
+        }
+
+        void CatalogueBuilder::AdoptNameStorage(std::shared_ptr<const void> owner, std::string_view region) {
+            catalogue_->names_.Adopt(std::move(owner), region);
+        }
+
+        std::shared_ptr<const TransportCatalogue> CatalogueBuilder::Build() {
+            catalogue_->Finalize();
+            catalogue_->version_ = ++last_catalogue_version;
+            std::shared_ptr<const TransportCatalogue> snapshot = std::move(catalogue_);
+            catalogue_ = std::make_unique<TransportCatalogue>();
+            return snapshot;
+        }
     } // конец namespace catalogue
 } // конец namespace transport
\ No newline at end of file
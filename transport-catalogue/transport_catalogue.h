@@ -5,20 +5,37 @@
  * 2) добавление остановки в базу (AddStop),
  * 3) поиск маршрута по имени (FindBus),
  * 4) поиск остановки по имени (FindStop),
- * 5) получение информации о маршруте (GetBusStatistics),
+ * 5) получение информации о маршруте (GetBusStatistics), статистика рассчитывается заранее в Finalize,
  * 6) получение сортированного списка автобусов, проходящих через остановку (GetStopStatistics).
  * 7) задание дистанции между остановками (AddStopDistances) (Расстояние между остановками A и B может быть как не равно,
  * так и равно расстоянию между остановками B и A. В первом случае расстояние между остановками указывается дважды:
  * в прямом и в обратном направлении. Когда расстояния одинаковы достаточно задать расстояние от A до B, либо расстояние от B до A.
  * Также разрешается задать расстояние от остановки до самой себя — так бывает, если автобус разворачивается и приезжает
  * на ту же остановку.),
- * 8) получение длины маршрута (CalculateTotalDistance) по географическим координатам и по расстояниям между остановками.
+ * 8) получение длины участка маршрута между любыми двумя позициями его остановок (GetSegmentDistance) за O(1)
+ * по географическим координатам и по расстояниям между остановками: префиксные суммы длин считаются в Finalize (CalculateBusSegments).
+ * 9) завершение наполнения справочника (Finalize): параллельный расчёт статистики всех маршрутов и построение пространственного индекса остановок.
+ * 10) поиск ближайших к точке остановок (NearestStops) и остановок внутри прямоугольника широт и долгот (StopsInBox).
+ * 11) поиск остановок и маршрутов по началу имени (FindStopsByPrefix, FindBusesByPrefix) - индексы имён строятся в Finalize.
+ * 12) остановки, через которые проходят маршруты, и все маршруты в лексикографическом порядке имён (GetServedStopsByName,
+ * GetBusesByName) - массивы указателей строятся в Finalize и отдаются без копирования.
+ * Имена остановок и маршрутов хранятся один раз в пуле строк names_, все остальные структуры ссылаются на них через std::string_view.
  * Методы класса TransportCatalogue не должны выполнять никакого ввода-вывода.
+ *
+ * Справочник наполняется только через CatalogueBuilder (методы 1, 2, 7, 9 закрыты). CatalogueBuilder::Build завершает справочник
+ * и отдаёт его как неизменяемый снимок std::shared_ptr<const TransportCatalogue>. Снимок можно без блокировок читать
+ * из нескольких потоков. Каждый снимок получает свой номер версии (GetVersion), по которому производные структуры
+ * (маршрутизатор, карта) проверяют, для какого снимка они построены.
  */
 
 #include "domain.h"
 #include "geo.h"
+#include "name_index.h"
+#include "ranges.h"
+#include "spatial_index.h"
+#include "string_pool.h"
 
+#include <cstdint>
 #include <deque>
 #include <functional>
 #include <memory>
@@ -26,7 +43,6 @@
 #include <string>
 #include <string_view>
 #include <unordered_map>
-#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -38,48 +54,138 @@ namespace transport {
             size_t measured;
         };
 
+        /* Префиксные суммы длин маршрута: элемент k - длина от первой остановки до позиции k полной последовательности остановок */
+        struct BusSegments {
+            std::vector<double> geographic;
+            std::vector<size_t> measured;
+        };
+
+        struct NearStop {
+            const Stop *stop;
+            double distance; // расстояние от заданной точки до остановки в метрах
+        };
+
         class TransportCatalogue {
         public:
             struct StopPointerHasher {
-                size_t operator()(const std::pair<Stop *, Stop *> &stops) const {
+                size_t operator()(const std::pair<const Stop *, const Stop *> &stops) const {
                     std::hash<const void *> ptr_hasher;
                     return static_cast<size_t>(ptr_hasher(stops.first)) + static_cast<size_t>(ptr_hasher(stops.second)) * 37;
                 }
             };
+            // расстояние между остановками: остановка "откуда", остановка "куда"
+            using StopsDistanceMap = std::unordered_map<std::pair<const Stop *, const Stop *>, size_t, StopPointerHasher>;
 
-            void AddStop(std::string_view stop_name, geo::Coordinates location);
+            TransportCatalogue() = default;
+            TransportCatalogue(const TransportCatalogue &) = delete;
+            TransportCatalogue &operator=(const TransportCatalogue &) = delete;
 
-            void AddStopDistances(std::string_view stop_name_from, std::string_view stop_name_to, size_t dist);
+            const Stop *FindStop(const std::string_view stop_name) const;
 
-            void AddBus(std::string_view bus_name, const std::vector<std::string_view> &stops, bool is_roundtrip = false);
+            const Bus *FindBus(const std::string_view bus_name) const;
 
-            Stop *FindStop(const std::string_view stop_name) const;
+            std::optional<BusStatistics> GetBusStatistics(const std::string_view bus_name) const;
 
-            Bus *FindBus(const std::string_view bus_name) const;
+            std::optional<std::vector<std::string_view>> GetStopStatistics(const std::string_view stop_name) const;
 
-            std::optional<BusStatistics> GetBusStatistics(const std::string_view bus_name) const;
+            /* Проходит ли через остановку хотя бы один маршрут */
+            bool IsStopServed(const Stop *stop) const;
 
-            std::optional<std::vector<std::string>> GetStopStatistics(const std::string_view stop_name) const;
+            /* Не более count остановок, ближайших к точке, по возрастанию расстояния */
+            std::vector<NearStop> NearestStops(geo::Coordinates point, size_t count) const;
 
-            std::vector<std::string> GetAllStopNames() const;
+            /* Остановки, у которых широта и долгота лежат в заданных пределах, отсортированные по имени */
+            std::vector<const Stop *> StopsInBox(geo::Coordinates min, geo::Coordinates max) const;
 
-            std::vector<std::string> GetAllBusNames() const;
+            /* Не более count остановок (маршрутов), имя которых начинается с prefix, в лексикографическом порядке */
+            ranges::Range<NameIndex<Stop>::Iterator> FindStopsByPrefix(std::string_view prefix, size_t count) const;
+            ranges::Range<NameIndex<Bus>::Iterator> FindBusesByPrefix(std::string_view prefix, size_t count) const;
+
+            /* Остановки, через которые проходит хотя бы один маршрут, в лексикографическом порядке имён */
+            ranges::Range<NameIndex<Stop>::Iterator> GetServedStopsByName() const;
+
+            /* Все маршруты в лексикографическом порядке имён */
+            ranges::Range<NameIndex<Bus>::Iterator> GetBusesByName() const;
 
             /* Расстояние между остановками исключительно рядом стоящими */
-            size_t GetDistanceBetwenStops(Stop *stop_from, Stop *stop_to) const;
+            size_t GetDistanceBetwenStops(const Stop *stop_from, const Stop *stop_to) const;
+
+            /*
+             * Длина участка маршрута от позиции from_pos до позиции to_pos полной последовательности остановок (Bus::GetRouteStops),
+             * from_pos <= to_pos < bus->GetRouteStopCount()
+             */
+            DistanceBetweenStops GetSegmentDistance(const Bus *bus, size_t from_pos, size_t to_pos) const;
 
             size_t GetStopCount() const;
 
+            /* Номер снимка справочника, уникальный в пределах процесса */
+            uint64_t GetVersion() const;
+
+            /* Все остановки и маршруты в порядке добавления и заданные расстояния справочника - для сохранения снимка в файл и построения графа маршрутизатора */
+            ranges::Range<std::deque<Stop>::const_iterator> GetStops() const;
+            ranges::Range<std::deque<Bus>::const_iterator> GetBuses() const;
+            ranges::Range<StopsDistanceMap::const_iterator> GetStopDistances() const;
+
         private:
+            friend class CatalogueBuilder;
+
+            void AddStop(std::string_view stop_name, geo::Coordinates location);
+
+            void AddStopDistances(std::string_view stop_name_from, std::string_view stop_name_to, size_t dist);
+
+            /* Если статистика маршрута передана (например, из снимка в файле), Finalize её не пересчитывает */
+            void AddBus(std::string_view bus_name, const std::vector<std::string_view> &stops, bool is_roundtrip = false,
+                        const std::optional<BusStatistics> &bus_stat = std::nullopt);
+
+            /* Рассчитывает статистику всех маршрутов. Вызывается один раз после добавления всех остановок, расстояний и маршрутов */
+            void Finalize();
+
+            StringPool names_;
             std::deque<Stop> stops_;
             std::deque<Bus> buses_;
             std::unordered_map<std::string_view, Stop *> stop_names_;
             std::unordered_map<std::string_view, Bus *> bus_names_;
 
-            std::unordered_map<std::string_view, std::unordered_set<std::string>> buses_for_stop_;
-            std::unordered_map<std::pair<Stop *, Stop *>, size_t, StopPointerHasher> stops_dist_; // расстояние между остановками: остановка "откуда", остановка "куда"
+            std::vector<std::vector<std::string_view>> buses_for_stop_; // имена маршрутов по номеру остановки, сортируются в Finalize
+            StopsDistanceMap stops_dist_;
+            geo::SpatialIndex stops_index_; // строится в Finalize, id точки - номер остановки
+            NameIndex<Stop> stops_by_name_; // строится в Finalize
+            NameIndex<Bus> buses_by_name_;  // строится в Finalize
+            std::vector<const Stop *> served_stops_; // остановки с маршрутами, отсортированные по имени, строится в Finalize
+            std::vector<BusSegments> bus_segments_; // по номеру маршрута, строятся в Finalize
+            std::vector<bool> precomputed_bus_stat_; // по номеру маршрута: статистика получена готовой и не пересчитывается
+            bool is_finalized_ = false;
+            uint64_t version_ = 0;
+            const size_t min_buses_per_thread_ = 256; // маршрутов меньше - поток не запускаем
+
+            /* stop_points - координаты всех остановок по номеру остановки для пакетного расчёта географических длин */
+            BusSegments CalculateBusSegments(const Bus *bus, const geo::PointArray &stop_points) const;
+            BusStatistics CalculateBusStatistics(const Bus *bus) const; // использует уже посчитанные bus_segments_
+        };
+
+        /*
+         * Изменяемая часть справочника: наполнение остановками, расстояниями и маршрутами.
+         * Build завершает справочник (Finalize) и передаёт его в неизменяемый снимок, после чего строитель пуст
+         * и готов к наполнению следующего справочника (например, при загрузке нового суточного набора данных).
+         */
+        class CatalogueBuilder {
+        public:
+            CatalogueBuilder();
 
-            DistanceBetweenStops CalculateTotalDistance(const Bus *bus) const; // возвращает длины маршрута: по географическим координатам и по расстояниям между остановками
+            void AddStop(std::string_view stop_name, geo::Coordinates location);
+
+            void AddStopDistances(std::string_view stop_name_from, std::string_view stop_name_to, size_t dist);
+
+            void AddBus(std::string_view bus_name, const std::vector<std::string_view> &stops, bool is_roundtrip = false,
+                        const std::optional<BusStatistics> &bus_stat = std::nullopt);
+
+            /* Имена остановок и маршрутов, лежащие внутри region, справочник не копирует, а удерживает owner - владельца этой памяти */
+            void AdoptNameStorage(std::shared_ptr<const void> owner, std::string_view region);
+
+            std::shared_ptr<const TransportCatalogue> Build();
+
+        private:
+            std::unique_ptr<TransportCatalogue> catalogue_;
         };
     } // конец namespace catalogue
 } // конец namespace transport
\ No newline at end of file
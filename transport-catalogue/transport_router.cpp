@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <iterator>
+#include <utility>
 
 namespace transport_router {
     using namespace std;
@@ -16,8 +17,8 @@ namespace transport_router {
      * 1) добавление вершин, добавление рёбер ожиданий,
      * 2) добавление рёбер маршрутов.
      */
-    RouteBuilder::RouteBuilder(const TransportCatalogue &transport_catalogue, const RouterSetting &settings)
-                : transport_catalogue_(transport_catalogue), router_settings_(settings) {
+    RouteBuilder::RouteBuilder(std::shared_ptr<const TransportCatalogue> transport_catalogue, const RouterSetting &settings)
+                : catalogue_snapshot_(std::move(transport_catalogue)), transport_catalogue_(*catalogue_snapshot_), router_settings_(settings) {
         size_t data_size = transport_catalogue_.GetStopCount() * 2;
         stops_.resize(data_size, nullptr);
         graph_ = new DirectedWeightedGraph<double>(data_size);
@@ -28,10 +29,14 @@ namespace transport_router {
     }
 
     void RouteBuilder::VertexFill() {
-        vector<string> all_stop_names = transport_catalogue_.GetAllStopNames();
+        // остановки и маршруты перебираются в порядке добавления в справочник: от порядка вершин и рёбер зависит,
+        // какой из маршрутов одинаковой длительности найдёт Router
         VertexId vid = 0;
-        for (auto it = all_stop_names.begin(); it != all_stop_names.end(); ++it) {
-            Stop *temp_stop = transport_catalogue_.FindStop(*it);
+        for (const Stop &stop : transport_catalogue_.GetStops()) {
+            if (!transport_catalogue_.IsStopServed(&stop)) {
+                continue;
+            }
+            const Stop *temp_stop = &stop;
             /* чётные вершины - для маршрутов, т.е. отсюда выезжают автобусы */
             stops_[vid] = temp_stop;
             vertexes_[temp_stop] = vid;
@@ -50,30 +55,35 @@ namespace transport_router {
      * он будет вынужден выйти и подождать тот же самый автобус ровно bus_wait_time минут.
      */
     void RouteBuilder::EdgesFill() {
-        vector<string> all_bus_names = transport_catalogue_.GetAllBusNames();
-
-        for (auto it = all_bus_names.begin(); it != all_bus_names.end(); ++it) {
-            Bus *bus = transport_catalogue_.FindBus(*it);
-
-            if (bus->stops.begin() == bus->stops.end()) {
-                continue; // в граф не включаются маршруты без остановок
-            }
-            if (next(bus->stops.begin()) == bus->stops.end()) {
-                continue; // в граф не включаются маршруты из одной остановки
+        for (const Bus &route : transport_catalogue_.GetBuses()) {
+            const Bus *bus = &route;
+            if (bus->stops.size() < 2) {
+                continue; // в граф не включаются маршруты без остановок и из одной остановки
             }
 
             if (bus->is_roundtrip_) {
-                InsertEdgesForRoute(bus->stops.begin(), bus->stops.end(), bus);
+                InsertEdgesForRoute(bus, 0, bus->stops.size());
             } else {
-                auto konechnaya_it = prev(bus->stops.end(), static_cast<long long int>(bus->stops.size() / 2));
-                InsertEdgesForRoute(bus->stops.begin(), konechnaya_it, bus);
-                InsertEdgesForRoute(prev(konechnaya_it), bus->stops.end(), bus);
+                // прямое направление и обратное, начинающееся на конечной остановке
+                InsertEdgesForRoute(bus, 0, bus->stops.size());
+                InsertEdgesForRoute(bus, bus->stops.size() - 1, bus->GetRouteStopCount());
+            }
+        }
+    }
+
+    void RouteBuilder::InsertEdgesForRoute(const Bus* bus, size_t begin_pos, size_t end_pos) {
+        for (size_t from_pos = begin_pos; from_pos + 1 < end_pos; ++from_pos) {
+            const VertexId from_vid = vertexes_.at(bus->GetRouteStop(from_pos));
+            for (size_t to_pos = from_pos + 1; to_pos != end_pos; ++to_pos) {
+                const VertexId to_vid = vertexes_.at(bus->GetRouteStop(to_pos));
+                const double edge_weight = router_settings_.GetTravelTime(transport_catalogue_.GetSegmentDistance(bus, from_pos, to_pos).measured);
+                buses_[graph_->AddEdge({from_vid, to_vid + 1, edge_weight})] = bus; // рёбра в нечётные вершины - сюда приезжают автобусы
             }
         }
     }
 
     bool RouteBuilder::IsStopValid(std::string_view stop_name) const {
-        Stop *stop = transport_catalogue_.FindStop(stop_name);
+        const Stop *stop = transport_catalogue_.FindStop(stop_name);
         if ((stop != nullptr) && (vertexes_.count(stop) > 0)) {
             return true;
         }
@@ -94,19 +104,19 @@ namespace transport_router {
         }
 
         FoundRouteResult result = {result_route->weight, {}};
-        FoundRouteResult::Wait wait_on_entering_station{string(from_station), static_cast<double>(router_settings_.bus_wait_time)};
+        FoundRouteResult::Wait wait_on_entering_station{transport_catalogue_.FindStop(from_station)->name, static_cast<double>(router_settings_.bus_wait_time)};
         result.route.emplace_back(move(wait_on_entering_station));
 
         for (const EdgeId edge_id : result_route->edges) {
             if (buses_.at(edge_id).has_value()) { // поездка
-                Stop* from_stop = stops_[graph_->GetEdge(edge_id).from];
-                Stop* to_stop = stops_[graph_->GetEdge(edge_id).to];
-                Bus* bus = *buses_.at(edge_id);
+                const Stop* from_stop = stops_[graph_->GetEdge(edge_id).from];
+                const Stop* to_stop = stops_[graph_->GetEdge(edge_id).to];
+                const Bus* bus = *buses_.at(edge_id);
                 size_t span_count = 0;
                 bool found_from_stop = false;
                 bool found_to_stop = false;
 
-                for (Stop* stop : bus->stops) {
+                for (const Stop* stop : bus->GetRouteStops()) {
                     if (from_stop == stop) {found_from_stop = true;}
                     if (to_stop == stop) {found_to_stop = true;}
                     if ((found_from_stop && !found_to_stop) || (!found_from_stop && found_to_stop)) {
@@ -120,7 +130,7 @@ namespace transport_router {
                 FoundRouteResult::Bus bus_result{span_count, bus->name, graph_->GetEdge(edge_id).weight};
                 result.route.emplace_back(move(bus_result));
             } else { // пересадка
-                Stop* from_stop = stops_[graph_->GetEdge(edge_id).from];
+                const Stop* from_stop = stops_[graph_->GetEdge(edge_id).from];
                 FoundRouteResult::Wait wait_result{from_stop->name, graph_->GetEdge(edge_id).weight};
                 result.route.emplace_back(move(wait_result));
             }
@@ -130,4 +140,45 @@ namespace transport_router {
         }
         return result;
     }
+    void RouterCache::Prepare(const std::shared_ptr<const TransportCatalogue> &catalogue, const RouterSetting &settings) {
+        RouterFuture replaced; // объявлен до блокировки, чтобы освобождаться уже после её снятия
+        std::lock_guard lock(mutex_);
+        StartBuild(catalogue, settings, replaced);
+    }
+
+    std::shared_ptr<const RouteBuilder> RouterCache::GetRouter(const std::shared_ptr<const TransportCatalogue> &catalogue,
+                                                               const RouterSetting &settings) {
+        RouterFuture replaced;
+        RouterFuture router;
+        uint64_t build_id = 0;
+        {
+            std::lock_guard lock(mutex_);
+            router = StartBuild(catalogue, settings, replaced);
+            build_id = build_id_;
+        }
+        try {
+            return router.get(); // ожидание - вне блокировки, чтобы не задерживать запросы к уже готовому маршрутизатору
+        } catch (...) {
+            // ожидающие потоки получат ту же ошибку, а следующий запрос начнёт построение заново
+            std::lock_guard lock(mutex_);
+            if (build_id_ == build_id) {
+                router_ = {};
+            }
+            throw;
+        }
+    }
+
+    RouterCache::RouterFuture RouterCache::StartBuild(const std::shared_ptr<const TransportCatalogue> &catalogue, const RouterSetting &settings,
+                                                      RouterFuture &replaced) {
+        if (!router_.valid() || catalogue_ != catalogue || settings_ != settings) {
+            replaced = std::exchange(router_, std::async(std::launch::async, [catalogue, settings] {
+                return std::make_shared<const RouteBuilder>(catalogue, settings);
+            }).share());
+            ++build_id_;
+            catalogue_ = catalogue;
+            settings_ = settings;
+        }
+        return router_;
+    }
+
 } // namespace transport_router
\ No newline at end of file
@@ -20,7 +20,10 @@
 #include "router.h"
 #include "transport_catalogue.h"
 
+#include <cstdint>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -32,17 +35,30 @@ namespace transport_router {
 
     struct RouterSetting {
         int bus_wait_time;
-        double bus_velocity;
+        double bus_velocity; // в метрах в минуту
+
+        /* Время проезда (в минутах) дорожного расстояния distance (в метрах) */
+        double GetTravelTime(size_t distance) const {
+            return static_cast<double>(distance) / bus_velocity;
+        }
+
+        bool operator==(const RouterSetting &other) const {
+            return bus_wait_time == other.bus_wait_time && bus_velocity == other.bus_velocity;
+        }
+        bool operator!=(const RouterSetting &other) const {
+            return !(*this == other);
+        }
     };
 
+    /* Имена остановок и маршрутов ссылаются на строки транспортного справочника */
     struct FoundRouteResult {
         struct Wait {
-            std::string stop;
+            std::string_view stop;
             double time;
         };
         struct Bus {
             size_t span_count;
-            std::string bus;
+            std::string_view bus;
             double time;
         };
 
@@ -52,8 +68,12 @@ namespace transport_router {
 
     class RouteBuilder {
     public:
-        explicit RouteBuilder(const transport::catalogue::TransportCatalogue& transport_catalogue, const RouterSetting& settings);
+        /* Маршрутизатор владеет снимком справочника, по которому построен граф: снимок живёт, пока жив маршрутизатор */
+        explicit RouteBuilder(std::shared_ptr<const transport::catalogue::TransportCatalogue> transport_catalogue, const RouterSetting& settings);
         std::optional<FoundRouteResult> FindRoute(std::string_view from_station, std::string_view to_station) const;
+        const std::shared_ptr<const transport::catalogue::TransportCatalogue>& GetCatalogue() const {
+            return catalogue_snapshot_;
+        }
         ~RouteBuilder() {
             if (graph_ != nullptr) {delete(graph_);}
             if (router_ != nullptr) {delete(router_);}
@@ -62,38 +82,54 @@ namespace transport_router {
     private:
         void VertexFill();
         void EdgesFill();
-        /* Внесение рёбер графа. Подаём на вход итераторы на начало и конец диапазона остановок, указатель на автобус*/
-        template <typename IterCatalogueStops>
-        void InsertEdgesForRoute(IterCatalogueStops begin_it, IterCatalogueStops end_it, transport::catalogue::Bus* bus) {
-            using namespace graph;
-            using namespace transport::catalogue;
-
-            for (auto from_it = begin_it; from_it != std::prev(end_it); ++from_it) {
-                VertexId from_vid = vertexes_.at(*from_it);
-                double edge_weight = 0.;
-                Stop *old_from_stop = *from_it;
-                for (auto to_it = std::next(from_it); to_it != end_it; ++to_it) {
-                    VertexId to_vid = vertexes_.at(*to_it);
-                    size_t distance_betwen_stops = transport_catalogue_.GetDistanceBetwenStops(old_from_stop, *to_it);
-                    if (distance_betwen_stops == 0) {
-                        distance_betwen_stops = transport_catalogue_.GetDistanceBetwenStops(*to_it, old_from_stop);
-                    }
-                    edge_weight += static_cast<double>(distance_betwen_stops) / router_settings_.bus_velocity;
-                    buses_[graph_->AddEdge({from_vid, to_vid + 1, edge_weight})] = bus; // рёбра в нечётные вершины - сюда приезжают автобусы
-                    old_from_stop = *to_it;
-                }
-            }
-        }
+        /*
+         * Внесение рёбер графа между всеми парами позиций [begin_pos, end_pos) полной последовательности остановок маршрута.
+         * Время проезда берётся из префиксных сумм справочника (GetSegmentDistance) за O(1) на ребро.
+         */
+        void InsertEdgesForRoute(const transport::catalogue::Bus* bus, size_t begin_pos, size_t end_pos);
         bool IsStopValid(std::string_view stop) const;
 
+        std::shared_ptr<const transport::catalogue::TransportCatalogue> catalogue_snapshot_;
         const transport::catalogue::TransportCatalogue& transport_catalogue_;
-        const RouterSetting& router_settings_;
+        const RouterSetting router_settings_;
         graph::DirectedWeightedGraph<double>* graph_ = nullptr;
         graph::Router<double>* router_ = nullptr;
-        std::vector<transport::catalogue::Stop*> stops_;
+        std::vector<const transport::catalogue::Stop*> stops_;
         /* Если будет много операций построения маршрута, то в хэше vertexes_ ключ можно попробовать поменять на string */
-        std::unordered_map<transport::catalogue::Stop*, graph::VertexId> vertexes_; /* только для чётных вершин графа - отсюда выезжают автобусы */
-        std::unordered_map<graph::EdgeId, std::optional<transport::catalogue::Bus*>> buses_; /* рёбра ожидания на остановке имеют значение nullopt */
+        std::unordered_map<const transport::catalogue::Stop*, graph::VertexId> vertexes_; /* только для чётных вершин графа - отсюда выезжают автобусы */
+        std::unordered_map<graph::EdgeId, std::optional<const transport::catalogue::Bus*>> buses_; /* рёбра ожидания на остановке имеют значение nullopt */
+    };
+
+    /*
+     * Маршрутизатор последнего запрошенного снимка справочника, общий для обработчиков запросов из разных потоков и пачек.
+     * 1) Prepare начинает строить маршрутизатор в фоновом потоке и сразу возвращает управление: пока он строится,
+     * можно отвечать на запросы, которым маршрутизатор не нужен.
+     * 2) GetRouter ждёт маршрутизатор, который строится или уже построен для этого снимка и настроек, иначе начинает построение сам.
+     * Маршрутизатор строится один раз на снимок и значение настроек. Ошибка построения выбрасывается из GetRouter
+     * и не запоминается: следующий вызов строит маршрутизатор заново.
+     */
+    class RouterCache {
+    public:
+        void Prepare(const std::shared_ptr<const transport::catalogue::TransportCatalogue> &catalogue, const RouterSetting &settings);
+        std::shared_ptr<const RouteBuilder> GetRouter(const std::shared_ptr<const transport::catalogue::TransportCatalogue> &catalogue,
+                                                      const RouterSetting &settings);
+
+    private:
+        using RouterFuture = std::shared_future<std::shared_ptr<const RouteBuilder>>;
+
+        /*
+         * Маршрутизатор для снимка и настроек: готовый, строящийся или только что запущенный. Вызывается под mutex_.
+         * Вытесненный маршрутизатор переносится в replaced: деструктор future от std::async ждёт конца построения,
+         * поэтому освобождать его надо после снятия блокировки.
+         */
+        RouterFuture StartBuild(const std::shared_ptr<const transport::catalogue::TransportCatalogue> &catalogue, const RouterSetting &settings,
+                                RouterFuture &replaced);
+
+        std::mutex mutex_;
+        RouterFuture router_;
+        uint64_t build_id_ = 0; // номер построения router_: отличает его от построений, запущенных позже
+        std::shared_ptr<const transport::catalogue::TransportCatalogue> catalogue_; // снимок, для которого строится router_
+        RouterSetting settings_{};
     };
 
 } // namespace transport_router
\ No newline at end of file